@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include<stdio.h>
 #include<string.h>
 #include<stdlib.h>
@@ -11,328 +12,2095 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <limits.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include "simple_scheduler.h"
 
-int front= 0 , rear = 0 , NCPU , TSLICE , count_Submits , fd , cpu_counter , old_head;
-char history[100][100];
-int pid_history[100],  child_pid;
-long time_history[100][2],start_time , wait_history[100];
+#define MAX_EVENTS 16
+#define POOL_CHUNK 1024
+#define SPAWN_STACK (64 * 1024)   // stack for a spawned job until it execs
+#define INITIAL_QUEUE_SIZE 256
+#define LEVELS 4    // priorities 1..4 map to mlfq levels 0..3
+
+#define NICE_0_WEIGHT 1024
+
+enum { POLICY_RR , POLICY_MLFQ , POLICY_CFS , POLICY_SRTF , POLICY_EDF , POLICY_LOTTERY , POLICY_STRIDE } policy = POLICY_RR;
+bool reject_late = false;   // edf: refuse jobs that cannot make their deadline instead of flagging them
+long min_run = 0;   // ns a job keeps its cpu before an arrival may preempt it
+int lookahead = 4;   // queued jobs per run queue that already have a stopped process behind them
+long age_interval = 0;   // mlfq: ns of waiting that raise a job one level, 0 disables aging
+const long priority_weight[LEVELS] = {3121, 1024, 335, 110};   // cfs share of priorities 1..4
+long min_vruntime = 0 , min_pass = 0;
+#define STRIDE1 (1L << 20)   // stride = STRIDE1 / tickets
+
+typedef struct Group {
+    char name[32];
+    long tickets;     // the live members' own tickets, pooled and shared evenly
+    int members;
+    struct Submit *live;   // the members, through Submit.next_member
+    struct Group *next;
+} Group;
+Group *groups = NULL;
+long quantum[LEVELS];   // time slice in ns for priorities 1..4, TSLICE unless -q is given
+
+#define ADAPT_WINDOW 16   // bursts observed per level before its quantum is retuned
+
+typedef struct {
+    long burst;           // moving average of cpu bursts that ended before the quantum, ns
+    int early , preempted;
+} Adapt;
+Adapt adapt[LEVELS];
+
+typedef struct {
+    char *path;       // NULL marks an empty bucket
+    long runtime;     // exponential average of cpu per run, ns
+} Estimate;
+Estimate *estimates = NULL;   // open-addressing hash table keyed by executable path
+int estimate_capacity = 0 , count_estimates = 0;
+char estimate_file[4096];
+bool adaptive = false;
+long quantum_min , quantum_max;
+
+int NCPU , count_Submits , listen_fd , busy_slots = 0 , queued = 0;
+long TSLICE;            // ns
+int epoll_fd , signal_fd , timer_fd;
+bool running = false;
+int child_pid;
+long start_time;
 bool flag_for_Input = true;
-int count_history = 0;
+int count_history = 0 , history_capacity = 0;
 char message_str[256];
 
-typedef struct {
-    int pid , priority;
-    char** command; 
-    long start_time , end_time , wait_time;
-    int start_flag;
-} Submit;
-Submit queue[200];
-struct itimerspec timer_spec; 
-timer_t timerid;
-
-void sort_queue() {
-    int count , j;
-    Submit temp;
-    for (int i = front; i < rear; i++) {
-        count = 0;
-        j = i;
-        while (j < rear - 1)
+typedef struct Session {
+    int id , client;        // client is -1 once its shell has disconnected
+    int next_job;           // job ids are handed out per session, from 1
+    int active;             // jobs released by "run" that have not finished yet
+    bool running;           // "run" was sent and some of its jobs are still around
+    bool subscribed , subscribed_all;   // wants MSG_STARTED/MSG_EXITED for its own or for all jobs
+    JobEvent *outbox;       // replies and events the shell's socket had no room for yet
+    int outbox_head , outbox_count , outbox_capacity;
+    int ack_first , ack_count;   // accepted submits not yet acknowledged, see flush_acks()
+    bool ack_released;      // those submits went straight to the run queues, no "run" needed
+    struct Submit *pending , *pending_tail;   // submitted, waiting for the session's "run"
+    struct Session *next;
+} Session;
+Session *sessions = NULL;
+int count_sessions = 0;
+bool keep_alive = false , served = false;   // -k: stay up when the last shell has left and all is done
+
+typedef struct Submit {
+    int id;           // per session, see Session.next_job
+    Session *session;
+    struct Submit *next_pending;
+    int pid , priority , level;   // pid is 0 until the job is spawned near the queue head, it is also the job's process group
+    char** command;   // argv, NULL terminated; one block that also holds env, cwd and the strings
+    char **env;       // NAME=VALUE pairs layered over the scheduler's environment
+    char *cwd;        // "" runs the job in the scheduler's directory
+    long start_time , end_time , wait_time;
+    long submit_time;     // when the scheduler queued it
+    long enqueued_at;     // when it last entered a run queue, settled into wait_time on dispatch
+    long dispatch_time;   // when it last got a slot
+    long slot_time;       // total time spent holding a slot, running or blocked
+    int status;           // wait status of the job's first process, from wait4()
+    struct rusage usage;  // summed over every process of the job reaped so far
+    int leader_done;      // the first process has exited, its helpers may still be running
+    long slice_cpu;   // cpu time of the job when its current quantum began
+    long vruntime;    // cfs: weighted cpu time in ns
+    long cpu_used;    // cpu consumed in completed quanta, ns
+    long estimate;    // srtf: expected total cpu, from the runtime history of its executable
+    long deadline;    // absolute monotonic ns, LONG_MAX when submitted without -d
+    int at_risk;      // edf admission expected it to miss the deadline
+    long pass;        // stride: advances by the job's stride for every quantum it uses
+    Group *group;     // lottery/stride ticket group, NULL when submitted without -g
+    long weight;      // tickets it brought into its group
+    long inherited;   // tickets passed on by members that finished while this one was live
+    struct Submit *next_member;
+    long key;         // heap ordering key, set by ready_push()
+    int last_slot;    // slot the job last ran on, -1 before its first dispatch
+    int start_flag , finished;
+    int stopped;      // SIGSTOP sent and not yet undone by SIGCONT
+    int gate;         // write end of the start gate, -1 when there is no child waiting on it
+    int exec_status;  // read end of the child's exec status pipe
+    char *stack;      // the spawned child runs on this until it execs
+    struct Submit *next_free;
+} Submit;
+
+typedef struct {
+    Submit **jobs;    // circular buffer of pointers, capacity is always a power of two
+    int head , count , capacity;
+} RunQueue;
+
+typedef struct {
+    Submit **jobs;    // binary min-heap on Submit.key
+    int count , capacity;
+} Heap;
+
+typedef struct {
+    RunQueue fifo;              // round robin
+    RunQueue level[LEVELS];     // mlfq, one fifo per level, level 0 runs first
+    unsigned int bitmap;        // bit l is set while level[l] is non-empty
+    Heap heap;                  // cfs, srtf, edf and stride, min-heap on key
+    Heap pool;                  // lottery, unordered
+    int count;
+} Ready;
+Ready *ready;       // one run queue per slot
+Submit *free_submits = NULL;
+Submit **expired;    // jobs whose quantum ran out, left running until we know they lost their cpu
+int count_expired = 0;
+
+typedef struct {
+    char command[100];
+    int session , id;
+    int pid , status;
+    long start_time , end_time , wait_time;
+    long submit_time , slot_time , deadline;
+    int at_risk;
+    long user_time , system_time;   // ns, from the kernel's rusage
+    long voluntary_switches , involuntary_switches , max_rss;
+} History;
+History *history = NULL;
+
+typedef struct {
+    Submit *job;      // job on this cpu, NULL when idle
+    long deadline;    // monotonic ns at which its quantum runs out
+    long quantum;     // length of the quantum the current job was given
+    int cpu;          // core the slot's jobs are pinned to
+    int heap_pos;     // index in deadline_heap, -1 when idle
+} Slot;
+Slot *slots;
+int *deadline_heap , deadline_count = 0;   // busy slots, earliest deadline on top
+
+
+long cpu_time(int pid){
+    // consumed cpu of a child in ns, -1 once it can no longer be queried
+    clockid_t clock;
+    struct timespec used;
+    if (clock_getcpuclockid(pid, &clock) != 0 || clock_gettime(clock, &used) != 0) {
+        return -1;
+    }
+    return used.tv_sec * NSEC_PER_SEC + used.tv_nsec;
+}
+
+void add_usage(struct rusage *total , struct rusage *more){
+    timeradd(&total->ru_utime, &more->ru_utime, &total->ru_utime);
+    timeradd(&total->ru_stime, &more->ru_stime, &total->ru_stime);
+    total->ru_nvcsw += more->ru_nvcsw;
+    total->ru_nivcsw += more->ru_nivcsw;
+    if (more->ru_maxrss > total->ru_maxrss) {
+        total->ru_maxrss = more->ru_maxrss;
+    }
+}
+
+long get_time(){
+    // every scheduler timestamp is CLOCK_MONOTONIC in ns, immune to wall-clock adjustments
+    struct timespec time;
+    if (clock_gettime(CLOCK_MONOTONIC, &time) != 0) {
+        printf("Error in getting the time.\n");
+        exit(1);
+    }
+    return time.tv_sec * NSEC_PER_SEC + time.tv_nsec;
+}
+
+long timeval_ns(struct timeval tv){
+    return tv.tv_sec * NSEC_PER_SEC + tv.tv_usec * 1000;
+}
+
+long job_cpu(Submit *submit){
+    // cpu of the processes of the job already reaped, plus the first one while it is alive
+    long cpu = timeval_ns(submit->usage.ru_utime) + timeval_ns(submit->usage.ru_stime);
+    if (!submit->leader_done) {
+        long live = cpu_time(submit->pid);
+        cpu += live > 0 ? live : 0;
+    }
+    return cpu;
+}
+
+Submit* new_submit(){
+    // job records are carved out of chunks and recycled, never freed one by one
+    if (free_submits == NULL) {
+        Submit *chunk = (Submit*)malloc(sizeof(Submit) * POOL_CHUNK);
+        if (chunk == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        for (int i = 0; i < POOL_CHUNK; i++)
+        {
+            chunk[i].next_free = free_submits;
+            free_submits = &chunk[i];
+        }
+    }
+    Submit *submit = free_submits;
+    free_submits = submit->next_free;
+    memset(submit, 0, sizeof(Submit));
+    submit->gate = -1;
+    return submit;
+}
+
+void free_submit(Submit *submit){
+    free(submit->command);
+    submit->next_free = free_submits;
+    free_submits = submit;
+}
+
+void enqueue(RunQueue *rq , Submit *submit){
+    if (rq->count == rq->capacity) {
+        // unwrap into a buffer twice the size so head starts at 0 again
+        int capacity = rq->capacity ? rq->capacity * 2 : INITIAL_QUEUE_SIZE;
+        Submit **jobs = (Submit**)malloc(sizeof(Submit*) * capacity);
+        if (jobs == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        for (int i = 0; i < rq->count; i++)
+        {
+            jobs[i] = rq->jobs[(rq->head + i) & (rq->capacity - 1)];
+        }
+        free(rq->jobs);
+        rq->jobs = jobs;
+        rq->head = 0;
+        rq->capacity = capacity;
+    }
+    rq->jobs[(rq->head + rq->count) & (rq->capacity - 1)] = submit;
+    rq->count++;
+}
+
+Submit* dequeue(RunQueue *rq){
+    Submit *submit = rq->jobs[rq->head];
+    rq->head = (rq->head + 1) & (rq->capacity - 1);
+    rq->count--;
+    return submit;
+}
+
+Submit* queue_at(RunQueue *rq , int i){
+    return rq->jobs[(rq->head + i) & (rq->capacity - 1)];
+}
+
+void heap_push(Heap *heap , Submit *submit){
+    if (heap->count == heap->capacity) {
+        heap->capacity = heap->capacity ? heap->capacity * 2 : INITIAL_QUEUE_SIZE;
+        heap->jobs = (Submit**)realloc(heap->jobs, sizeof(Submit*) * heap->capacity);
+        if (heap->jobs == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    int i = heap->count++;
+    while (i > 0 && heap->jobs[(i - 1) / 2]->key > submit->key) {
+        heap->jobs[i] = heap->jobs[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->jobs[i] = submit;
+}
+
+Submit* heap_pop(Heap *heap){
+    Submit *top = heap->jobs[0];
+    Submit *last = heap->jobs[--heap->count];
+    int i = 0;
+    while (2 * i + 1 < heap->count) {
+        int child = 2 * i + 1;
+        if (child + 1 < heap->count && heap->jobs[child + 1]->key < heap->jobs[child]->key) {
+            child++;
+        }
+        if (last->key <= heap->jobs[child]->key) {
+            break;
+        }
+        heap->jobs[i] = heap->jobs[child];
+        i = child;
+    }
+    heap->jobs[i] = last;
+    return top;
+}
+
+long remaining(Submit *submit){
+    long left = submit->estimate - submit->cpu_used;
+    return left > 0 ? left : 0;
+}
+
+long tickets(Submit *submit){
+    // a grouped job draws an even share of its group's pool, others hold their priority's weight
+    if (submit->group != NULL) {
+        long share = submit->group->tickets / submit->group->members + submit->inherited;
+        return share > 0 ? share : 1;
+    }
+    return priority_weight[submit->level];
+}
+
+long pool_tickets(Heap *pool){
+    long total = 0;
+    for (int i = 0; i < pool->count; i++)
+    {
+        total += tickets(pool->jobs[i]);
+    }
+    return total;
+}
+
+Submit* draw_lottery(Heap *pool){
+    // pick a job with probability proportional to its tickets and swap-remove it
+    long total = pool_tickets(pool);
+    long winner = random() % total;
+    int i = 0;
+    while (winner >= tickets(pool->jobs[i])) {
+        winner -= tickets(pool->jobs[i]);
+        i++;
+    }
+    Submit *submit = pool->jobs[i];
+    pool->jobs[i] = pool->jobs[--pool->count];
+    return submit;
+}
+
+bool heap_policy(){
+    return policy == POLICY_CFS || policy == POLICY_SRTF || policy == POLICY_EDF || policy == POLICY_STRIDE;
+}
+
+void ready_push(Ready *rq , Submit *submit){
+    submit->enqueued_at = get_time();
+    switch (policy) {
+    case POLICY_CFS:
+        submit->key = submit->vruntime;
+        heap_push(&rq->heap, submit);
+        break;
+    case POLICY_SRTF:
+        submit->key = remaining(submit);
+        heap_push(&rq->heap, submit);
+        break;
+    case POLICY_EDF:
+        submit->key = submit->deadline;
+        heap_push(&rq->heap, submit);
+        break;
+    case POLICY_STRIDE:
+        submit->key = submit->pass;
+        heap_push(&rq->heap, submit);
+        break;
+    case POLICY_LOTTERY:
+        // same growth as the heap, just never ordered
+        submit->key = 0;
+        heap_push(&rq->pool, submit);
+        break;
+    case POLICY_MLFQ:
+        enqueue(&rq->level[submit->level], submit);
+        rq->bitmap |= 1u << submit->level;
+        break;
+    default:
+        enqueue(&rq->fifo, submit);
+    }
+    rq->count++;
+    queued++;
+}
+
+Submit* ready_pop(Ready *rq){
+    Submit *submit;
+    if (heap_policy()) {
+        submit = heap_pop(&rq->heap);
+        if (submit->vruntime > min_vruntime) {
+            min_vruntime = submit->vruntime;
+        }
+        if (submit->pass > min_pass) {
+            min_pass = submit->pass;
+        }
+    }
+    else if (policy == POLICY_LOTTERY) {
+        submit = draw_lottery(&rq->pool);
+    }
+    else if (policy == POLICY_MLFQ) {
+        // lowest set bit is the highest non-empty priority level
+        int l = __builtin_ctz(rq->bitmap);
+        int effective = l;
+        if (age_interval > 0) {
+            // every age_interval spent waiting counts as one level higher; each level is fifo so
+            // its head has waited longest and only the heads need checking. Equal levels go to
+            // whoever has waited longer.
+            long now = get_time();
+            long oldest = queue_at(&rq->level[l], 0)->enqueued_at;
+            for (int k = l + 1; k < LEVELS; k++)
+            {
+                if (rq->level[k].count == 0) {
+                    continue;
+                }
+                long since = queue_at(&rq->level[k], 0)->enqueued_at;
+                long boost = (now - since) / age_interval;
+                int aged = boost >= k ? 0 : k - (int)boost;
+                if (aged < effective || (aged == effective && since < oldest)) {
+                    effective = aged;
+                    oldest = since;
+                    l = k;
+                }
+            }
+        }
+        submit = dequeue(&rq->level[l]);
+        if (rq->level[l].count == 0) {
+            rq->bitmap &= ~(1u << l);
+        }
+        submit->level = effective;   // the boost sticks until the job uses up a quantum again
+    }
+    else{
+        submit = dequeue(&rq->fifo);
+    }
+    rq->count--;
+    queued--;
+    if (!submit->finished) {
+        submit->wait_time += get_time() - submit->enqueued_at;
+    }
+    return submit;
+}
+
+Submit* ready_nth(Ready *rq , int n){
+    // n-th queued job, roughly in the order ready_pop() would return them
+    if (heap_policy()) {
+        return rq->heap.jobs[n];
+    }
+    if (policy == POLICY_LOTTERY) {
+        return rq->pool.jobs[n];
+    }
+    if (policy == POLICY_MLFQ) {
+        for (int l = 0; l < LEVELS; l++)
+        {
+            if (n < rq->level[l].count) {
+                return queue_at(&rq->level[l], n);
+            }
+            n -= rq->level[l].count;
+        }
+    }
+    return queue_at(&rq->fifo, n);
+}
+
+void add_to_history(Submit *submit) {
+    if (count_history == history_capacity) {
+        history_capacity = history_capacity ? history_capacity * 2 : 100;
+        history = (History*)realloc(history, sizeof(History) * history_capacity);
+        if (history == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    History *entry = &history[count_history];
+    int used = 0;
+    entry->command[0] = '\0';
+    for (int i = 0; submit->command[i] != NULL && used < (int)sizeof(entry->command); i++)
+    {
+        used += snprintf(entry->command + used, sizeof(entry->command) - used, "%s%s", i ? " " : "", submit->command[i]);
+    }
+    entry->pid = submit->pid;
+    entry->status = submit->status;
+    entry->start_time = submit->start_time;
+    entry->session = submit->session->id;
+    entry->id = submit->id;
+    entry->end_time = submit->end_time;
+    entry->wait_time = submit->wait_time;
+    entry->submit_time = submit->submit_time;
+    entry->slot_time = submit->slot_time;
+    entry->deadline = submit->deadline;
+    entry->at_risk = submit->at_risk;
+    entry->user_time = timeval_ns(submit->usage.ru_utime);
+    entry->system_time = timeval_ns(submit->usage.ru_stime);
+    entry->voluntary_switches = submit->usage.ru_nvcsw;
+    entry->involuntary_switches = submit->usage.ru_nivcsw;
+    entry->max_rss = submit->usage.ru_maxrss;
+    count_history++;
+}
+
+int compare_long(const void *a , const void *b){
+    long x = *(const long*)a , y = *(const long*)b;
+    return (x > y) - (x < y);
+}
+
+void display_history() {
+    printf("-------------------------------\n");
+    printf("\n Command History for Scheduler: \n");
+    printf("-------------------------------\n");
+
+    for (int i = 0; i < count_history; i++) {
+        History *entry = &history[i];
+        printf("Command: %s\n", entry->command);
+        printf("Job: %d.%d (session.job)\n", entry->session, entry->id);
+        printf("PID: %d\n", entry->pid);
+        if (WIFSIGNALED(entry->status)) {
+            printf("Exit: killed by signal %d\n", WTERMSIG(entry->status));
+        }
+        else{
+            printf("Exit: status %d\n", WEXITSTATUS(entry->status));
+        }
+        printf("Execution Time: %.3f ms\n", (double)(entry->end_time - entry->start_time) / NSEC_PER_MSEC);
+        printf("Wait Time: %.3f ms\n", (double)entry->wait_time / NSEC_PER_MSEC);
+        // stopped = runnable but parked in a run queue, blocked = holding a slot without using the cpu
+        long cpu = entry->user_time + entry->system_time;
+        long stopped = entry->end_time - entry->submit_time - entry->slot_time;
+        long blocked = entry->slot_time > cpu ? entry->slot_time - cpu : 0;
+        printf("CPU Time: %.3f ms (user %.3f ms , sys %.3f ms)\n", (double)cpu / NSEC_PER_MSEC,
+               (double)entry->user_time / NSEC_PER_MSEC, (double)entry->system_time / NSEC_PER_MSEC);
+        printf("Stopped In Queue: %.3f ms , Blocked On CPU Slot: %.3f ms\n", (double)stopped / NSEC_PER_MSEC, (double)blocked / NSEC_PER_MSEC);
+        printf("Context Switches: %ld voluntary , %ld involuntary\n", entry->voluntary_switches, entry->involuntary_switches);
+        printf("Max RSS: %ld KB\n", entry->max_rss);
+        if (entry->deadline != LONG_MAX) {
+            long slack = entry->deadline - entry->end_time;
+            printf("Deadline: %s by %.3f ms%s\n", slack >= 0 ? "met" : "missed", (double)labs(slack) / NSEC_PER_MSEC,
+                   entry->at_risk ? " (flagged at submit)" : "");
+        }
+        printf("-------------------------------\n");
+    }
+
+    //calculating averages
+    long avg_waiting = 0 , avg_execution = 0 , avg_cpu = 0;
+    int with_deadline = 0 , on_time = 0;
+    for (int i = 0; i < count_history; i++)
+    {
+        if (history[i].deadline != LONG_MAX) {
+            with_deadline++;
+            on_time += history[i].end_time <= history[i].deadline;
+        }
+        avg_execution += history[i].end_time - history[i].start_time;
+        avg_waiting += history[i].wait_time; 
+        avg_cpu += history[i].user_time + history[i].system_time;
+    }
+    if (count_history > 0) {
+        avg_execution /= count_history;
+        avg_waiting /= count_history; 
+        avg_cpu /= count_history;
+    }
+    printf("Average execution Time: %.3f ms\n\n", (double)avg_execution / NSEC_PER_MSEC);
+    printf("Average Waiting Time: %.3f ms\n", (double)avg_waiting / NSEC_PER_MSEC);
+    printf("Average CPU Time: %.3f ms\n", (double)avg_cpu / NSEC_PER_MSEC);
+    if (count_history > 0) {
+        // tail of the wait distribution, nearest-rank percentiles
+        long *waits = (long*)malloc(sizeof(long) * count_history);
+        if (waits == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        for (int i = 0; i < count_history; i++)
+        {
+            waits[i] = history[i].wait_time;
+        }
+        qsort(waits, count_history, sizeof(long), compare_long);
+        printf("Waiting Time p95: %.3f ms , p99: %.3f ms , max: %.3f ms\n",
+               (double)waits[(count_history * 95 + 99) / 100 - 1] / NSEC_PER_MSEC,
+               (double)waits[(count_history * 99 + 99) / 100 - 1] / NSEC_PER_MSEC,
+               (double)waits[count_history - 1] / NSEC_PER_MSEC);
+        free(waits);
+    }
+    if (with_deadline > 0) {
+        printf("Deadlines Met: %d of %d\n", on_time, with_deadline);
+    }
+    if (adaptive) {
+        for (int l = 0; l < LEVELS; l++)
+        {
+            printf("Adapted quantum for priority %d: %.3f ms\n", l + 1, (double)quantum[l] / NSEC_PER_MSEC);
+        }
+    }
+    printf("-------------------------------\n");
+}
+
+unsigned long hash_path(char *path){
+    unsigned long hash = 14695981039346656037UL;   // FNV-1a
+    for (; *path; path++)
+    {
+        hash = (hash ^ (unsigned char)*path) * 1099511628211UL;
+    }
+    return hash;
+}
+
+Estimate* find_estimate(char *path , bool create){
+    if (create && (count_estimates + 1) * 10 > estimate_capacity * 7) {
+        // rehash into a table twice the size before it gets 70% full
+        Estimate *old = estimates;
+        int old_capacity = estimate_capacity;
+        estimate_capacity = estimate_capacity ? estimate_capacity * 2 : 64;
+        estimates = (Estimate*)calloc(estimate_capacity, sizeof(Estimate));
+        if (estimates == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        for (int i = 0; i < old_capacity; i++)
+        {
+            if (old[i].path != NULL) {
+                unsigned long h = hash_path(old[i].path) & (estimate_capacity - 1);
+                while (estimates[h].path != NULL) {
+                    h = (h + 1) & (estimate_capacity - 1);
+                }
+                estimates[h] = old[i];
+            }
+        }
+        free(old);
+    }
+    if (estimate_capacity == 0) {
+        return NULL;
+    }
+    unsigned long h = hash_path(path) & (estimate_capacity - 1);
+    while (estimates[h].path != NULL) {
+        if (!strcmp(estimates[h].path, path)) {
+            return &estimates[h];
+        }
+        h = (h + 1) & (estimate_capacity - 1);
+    }
+    if (!create) {
+        return NULL;
+    }
+    estimates[h].path = strdup(path);
+    estimates[h].runtime = 0;
+    count_estimates++;
+    return &estimates[h];
+}
+
+void executable_key(char *command , char *key , int size){
+    // "./fib" and "/home/me/fib" are the same program, bare names stay as typed
+    if (strchr(command, '/') == NULL || realpath(command, key) == NULL) {
+        snprintf(key, size, "%s", command);
+    }
+}
+
+void job_path(Submit *submit , char *path , int size){
+    // a relative program path is relative to the directory the job was submitted from
+    char *program = submit->command[0];
+    if (strchr(program, '/') != NULL && program[0] != '/' && submit->cwd[0] != '\0') {
+        snprintf(path, size, "%s/%s", submit->cwd, program);
+    }
+    else{
+        snprintf(path, size, "%s", program);
+    }
+}
+
+long lookup_estimate(char *command){
+    char key[4096];
+    executable_key(command, key, sizeof(key));
+    Estimate *e = find_estimate(key, false);
+    return e != NULL ? e->runtime : TSLICE;   // never seen: assume it fits in one slice
+}
+
+void record_runtime(char *command , long runtime){
+    char key[4096];
+    executable_key(command, key, sizeof(key));
+    Estimate *e = find_estimate(key, true);
+    e->runtime = e->runtime ? (e->runtime + runtime) / 2 : runtime;
+}
+
+void load_estimates(){
+    const char *home = getenv("HOME");
+    snprintf(estimate_file, sizeof(estimate_file), "%s/.simple_scheduler_runtimes", home ? home : "/tmp");
+    FILE *file = fopen(estimate_file, "r");
+    if (file == NULL) {
+        return;
+    }
+    long runtime;
+    char path[4096];
+    while (fscanf(file, "%ld %4095[^\n]", &runtime, path) == 2) {
+        find_estimate(path, true)->runtime = runtime;
+    }
+    fclose(file);
+}
+
+void save_estimates(){
+    FILE *file = fopen(estimate_file, "w");
+    if (file == NULL) {
+        printf("Could not save runtime history to %s\n", estimate_file);
+        return;
+    }
+    for (int i = 0; i < estimate_capacity; i++)
+    {
+        if (estimates[i].path != NULL) {
+            fprintf(file, "%ld %s\n", estimates[i].runtime, estimates[i].path);
+        }
+    }
+    fclose(file);
+}
+
+int queue_empty(){
+    return queued == 0;
+
+}
+
+void print_queue(){
+    printf("queued: %d\n" ,queued );
+    for (int s = 0; s < NCPU; s++)
+    {
+        for (int i = 0; i < ready[s].count; i++)
+        {
+            printf("\nslot: %d , pid: %d , Command_string : %s\n" , s , ready_nth(&ready[s], i)->pid , ready_nth(&ready[s], i)->command[0] );
+        }
+    }
+    
+}
+
+Submit* find_queued(int pid){
+    for (int s = 0; s < NCPU; s++)
+    {
+        for (int i = 0 ; i < ready[s].count; i++)
+        {
+            if (ready_nth(&ready[s], i)->pid == pid) {
+                return ready_nth(&ready[s], i);
+            }
+        }
+    }
+    return NULL;
+}
+
+int shortest_queue(){
+    int best = 0;
+    for (int s = 1; s < NCPU; s++)
+    {
+        if (ready[s].count < ready[best].count) {
+            best = s;
+        }
+    }
+    return best;
+}
+
+bool head_before(Ready *a , Ready *b){
+    // does the job at the head of a run ahead of b's under an ordering policy
+    if (heap_policy()) {
+        return a->heap.jobs[0]->key < b->heap.jobs[0]->key;
+    }
+    return __builtin_ctz(a->bitmap) < __builtin_ctz(b->bitmap);   // mlfq: higher level first
+}
+
+int draw_queue(){
+    // lottery: the slot whose pool holds the winning ticket among all queued tickets; the draw
+    // inside that pool then makes every job's chance its share of all tickets, on any slot
+    long total = 0;
+    for (int s = 0; s < NCPU; s++)
+    {
+        total += pool_tickets(&ready[s].pool);
+    }
+    long winner = random() % total;
+    for (int s = 0; s < NCPU; s++)
+    {
+        long held = pool_tickets(&ready[s].pool);
+        if (winner < held) {
+            return s;
+        }
+        winner -= held;
+    }
+    return 0;
+}
+
+Submit* pick_next(int s){
+    // run from our own queue to keep caches warm, otherwise steal from the longest one. Ordering
+    // policies take whichever queue's head ranks first, ours on a tie, so a job due sooner or of
+    // higher priority never waits behind another slot's backlog.
+    if (heap_policy() || policy == POLICY_MLFQ) {
+        int best = s;
+        for (int other = 0; other < NCPU; other++)
+        {
+            if (ready[other].count > 0 && (ready[best].count == 0 || head_before(&ready[other], &ready[best]))) {
+                best = other;
+            }
+        }
+        return ready_pop(&ready[best]);
+    }
+    if (policy == POLICY_LOTTERY) {
+        return ready_pop(&ready[draw_queue()]);
+    }
+    int longest = s;
+    for (int other = 0; other < NCPU; other++)
+    {
+        if (ready[other].count > ready[longest].count) {
+            longest = other;
+        }
+    }
+    // queue lengths stay within one of each other, or the jobs of a short queue get more cpu
+    if (ready[s].count > 0 && ready[longest].count <= ready[s].count + 1) {
+        return ready_pop(&ready[s]);
+    }
+    return ready_pop(&ready[longest]);
+}
+
+void deadline_swap(int i , int j){
+    int t = deadline_heap[i];
+    deadline_heap[i] = deadline_heap[j];
+    deadline_heap[j] = t;
+    slots[deadline_heap[i]].heap_pos = i;
+    slots[deadline_heap[j]].heap_pos = j;
+}
+
+void deadline_fix(int i){
+    while (i > 0 && slots[deadline_heap[i]].deadline < slots[deadline_heap[(i - 1) / 2]].deadline) {
+        deadline_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    while (2 * i + 1 < deadline_count) {
+        int child = 2 * i + 1;
+        if (child + 1 < deadline_count && slots[deadline_heap[child + 1]].deadline < slots[deadline_heap[child]].deadline) {
+            child++;
+        }
+        if (slots[deadline_heap[i]].deadline <= slots[deadline_heap[child]].deadline) {
+            break;
+        }
+        deadline_swap(i, child);
+        i = child;
+    }
+}
+
+void set_deadline(int s , long deadline){
+    slots[s].deadline = deadline;
+    if (slots[s].heap_pos == -1) {
+        slots[s].heap_pos = deadline_count;
+        deadline_heap[deadline_count++] = s;
+    }
+    deadline_fix(slots[s].heap_pos);
+}
+
+void release_slot(int s){
+    int i = slots[s].heap_pos;
+    slots[s].job->slot_time += get_time() - slots[s].job->dispatch_time;
+    slots[s].job = NULL;
+    slots[s].heap_pos = -1;
+    busy_slots--;
+    deadline_count--;
+    if (i != deadline_count) {
+        deadline_heap[i] = deadline_heap[deadline_count];
+        slots[deadline_heap[i]].heap_pos = i;
+        deadline_fix(i);
+    }
+}
+
+void pin_to_slot(Submit *submit , int s){
+    if (submit->last_slot == s) {
+        return;
+    }
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(slots[s].cpu, &mask);
+    sched_setaffinity(submit->pid, sizeof(mask), &mask);
+    submit->last_slot = s;
+}
+
+void join_group(Submit *submit , char *name){
+    Group *group;
+    for (group = groups; group != NULL; group = group->next)
+    {
+        if (!strcmp(group->name, name)) {
+            break;
+        }
+    }
+    if (group == NULL) {
+        group = (Group*)calloc(1, sizeof(Group));
+        if (group == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        snprintf(group->name, sizeof(group->name), "%s", name);
+        group->next = groups;
+        groups = group;
+    }
+    submit->group = group;
+    submit->weight = priority_weight[submit->level];
+    submit->next_member = group->live;
+    group->live = submit;
+    group->tickets += submit->weight;
+    group->members++;
+}
+
+void leave_group(Submit *submit){
+    // a job that ran hands what it held to the members live right now, and they take it with
+    // them when they leave in turn, so later members never inherit it and the pool cannot grow
+    // past what its live members hold; the group goes away with its last member
+    Group *group = submit->group;
+    long held = tickets(submit);
+    Submit **link_member = &group->live;
+    while (*link_member != submit) {
+        link_member = &(*link_member)->next_member;
+    }
+    *link_member = submit->next_member;
+    group->tickets -= submit->weight;
+    if (--group->members > 0) {
+        for (Submit *member = group->live; member != NULL && submit->start_flag; member = member->next_member)
+        {
+            member->inherited += held / group->members;
+        }
+        return;
+    }
+    Group **link = &groups;
+    while (*link != group) {
+        link = &(*link)->next;
+    }
+    *link = group->next;
+    free(group);
+}
+
+void watch_output(int client , bool on){
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = on ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    ev.data.fd = client;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client, &ev);
+}
+
+void flush_outbox(Session *session){
+    // on EPOLLOUT: as many queued events per packet as fit, until the socket fills up again
+    while (session->outbox_count > 0) {
+        int n = session->outbox_count;
+        if (n > MAX_PACKET / (int)sizeof(JobEvent)) {
+            n = MAX_PACKET / sizeof(JobEvent);
+        }
+        if (send(session->client, session->outbox + session->outbox_head, sizeof(JobEvent) * n, MSG_DONTWAIT | MSG_NOSIGNAL) == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            session->outbox_count = 0;   // the shell is gone, read_client() cleans up
+            break;
+        }
+        session->outbox_head += n;
+        session->outbox_count -= n;
+    }
+    session->outbox_head = 0;
+    watch_output(session->client, false);
+}
+
+void send_event(Session *session , JobEvent *event){
+    // never block on a shell: what its socket has no room for waits in the session's outbox,
+    // in order, and goes out on EPOLLOUT, so a shell that is slow to read loses nothing
+    if (session->client == -1) {
+        return;
+    }
+    if (session->outbox_count == 0) {
+        if (send(session->client, event, sizeof(JobEvent), MSG_DONTWAIT | MSG_NOSIGNAL) != -1) {
+            return;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return;   // the shell is gone, read_client() cleans up
+        }
+        watch_output(session->client, true);
+    }
+    if (session->outbox_head + session->outbox_count == session->outbox_capacity) {
+        if (session->outbox_head > 0) {
+            memmove(session->outbox, session->outbox + session->outbox_head, sizeof(JobEvent) * session->outbox_count);
+            session->outbox_head = 0;
+        }
+        else{
+            session->outbox_capacity = session->outbox_capacity ? session->outbox_capacity * 2 : 64;
+            session->outbox = (JobEvent*)realloc(session->outbox, sizeof(JobEvent) * session->outbox_capacity);
+            if (session->outbox == NULL) {
+                printf("Memory allocation failed\n");
+                exit(1);
+            }
+        }
+    }
+    session->outbox[session->outbox_head + session->outbox_count++] = *event;
+}
+
+void reply(Session *session , int type , int job , int count , bool released){
+    JobEvent event;
+    memset(&event, 0, sizeof(event));
+    event.header.length = sizeof(event);
+    event.header.type = type;
+    event.session = session->id;
+    event.job = job;
+    event.count = count;
+    event.released = released;
+    send_event(session, &event);
+}
+
+void flush_acks(Session *session){
+    // a packet or ring full of submits is acknowledged with one MSG_ACCEPTED
+    if (session != NULL && session->ack_count > 0) {
+        reply(session, MSG_ACCEPTED, session->ack_first, session->ack_count, session->ack_released);
+        session->ack_count = 0;
+    }
+}
+
+void notify(Submit *submit , int type){
+    JobEvent event;
+    memset(&event, 0, sizeof(event));
+    event.header.length = sizeof(event);
+    event.header.type = type;
+    event.session = submit->session->id;
+    event.job = submit->id;
+    event.pid = submit->pid;
+    if (type == MSG_EXITED) {
+        event.status = submit->status;
+        event.runtime = submit->end_time - submit->start_time;
+        event.wait = submit->wait_time;
+    }
+    for (Session *session = sessions; session != NULL; session = session->next)
+    {
+        if (session->subscribed_all || (session->subscribed && session == submit->session)) {
+            send_event(session, &event);
+        }
+    }
+}
+
+void session_job_done(Session *session){
+    if (--session->active > 0) {
+        return;
+    }
+    session->running = false;   // its next submits wait for another "run", as before
+    if (session->client != -1) {
+        return;
+    }
+    Session **link = &sessions;
+    while (*link != session) {
+        link = &(*link)->next;
+    }
+    *link = session->next;
+    free(session);
+}
+
+void finish_job(Submit *submit){
+    if (submit->gate != -1) {
+        // it died waiting on the gate, killed from outside before its first dispatch
+        close(submit->gate);
+        close(submit->exec_status);
+        free(submit->stack);
+    }
+    if (submit->group != NULL) {
+        leave_group(submit);
+    }
+    char path[4096];
+    job_path(submit, path, sizeof(path));
+    record_runtime(path, timeval_ns(submit->usage.ru_utime) + timeval_ns(submit->usage.ru_stime));
+    add_to_history(submit);
+    notify(submit, MSG_EXITED);
+    session_job_done(submit->session);
+    free_submit(submit);
+}
+
+void observe_burst(int level , long burst , bool preempted){
+    // adaptive mode: jobs that keep hitting the quantum get a longer one to cut switches,
+    // jobs that finish or block early pull it down towards their typical burst
+    if (!adaptive || burst < 0) {
+        return;
+    }
+    Adapt *a = &adapt[level];
+    if (preempted) {
+        a->preempted++;
+    }
+    else{
+        a->early++;
+        a->burst = a->burst ? (a->burst * 7 + burst) / 8 : burst;
+    }
+    if (a->early + a->preempted < ADAPT_WINDOW) {
+        return;
+    }
+    long next = quantum[level];
+    if (a->preempted * 5 > a->early + a->preempted) {
+        next = quantum[level] * 5 / 4;
+    }
+    else if (a->burst > 0) {
+        next = a->burst * 5 / 4;
+    }
+    if (next < quantum_min) {
+        next = quantum_min;
+    }
+    if (next > quantum_max) {
+        next = quantum_max;
+    }
+    quantum[level] = next;
+    a->early = 0;
+    a->preempted = 0;
+}
+
+void charge_slice(int s){
+    // settle the quantum that just ended on slot s against its job's policy state
+    Submit *submit = slots[s].job;
+    long used = job_cpu(submit) - submit->slice_cpu;
+    long held = get_time() - submit->dispatch_time;   // shorter than the quantum when an arrival cut in
+    if (used > 0) {
+        submit->cpu_used += used;
+    }
+    observe_burst(submit->level, used, used >= held / 2);
+    if (policy == POLICY_CFS) {
+        // heavier (higher priority) jobs age slower, so they get picked proportionally more often
+        submit->vruntime += used * NICE_0_WEIGHT / priority_weight[submit->level];
+    }
+    if (policy == POLICY_STRIDE && used > 0) {
+        // charge the fraction of the quantum actually used, so blocking early is not penalised
+        long stride = STRIDE1 / tickets(submit);
+        submit->pass += (stride > 0 ? stride : 1) * used / slots[s].quantum;
+    }
+    if (policy == POLICY_MLFQ) {
+        // burning the whole quantum demotes, spending most of it blocked promotes
+        if (held >= slots[s].quantum * 9 / 10 && used >= held * 9 / 10 && submit->level < LEVELS - 1) {
+            submit->level++;
+        }
+        else if (used < held / 2 && submit->level > 0) {
+            submit->level--;
+        }
+    }
+}
+
+void requeue_slot(int s){
+    // back on its own queue for the caches, unless another one is shorter: otherwise a slot
+    // with nothing else queued hands its job straight back while the rest queue up elsewhere
+    Submit *submit = slots[s].job;
+    int shortest = shortest_queue();
+    charge_slice(s);
+    ready_push(&ready[ready[shortest].count < ready[s].count ? shortest : s], submit);
+    release_slot(s);
+}
+
+void preempt_slot(int s){
+    kill(-slots[s].job->pid, SIGSTOP);
+    slots[s].job->stopped = 1;
+    requeue_slot(s);
+}
+
+void renew_slot(int s){
+    // nobody is waiting for this cpu, so the job keeps running into a fresh quantum without
+    // being stopped and continued
+    Submit *submit = slots[s].job;
+    charge_slice(s);
+    long now = get_time();
+    submit->slot_time += now - submit->dispatch_time;
+    submit->dispatch_time = now;
+    submit->slice_cpu = job_cpu(submit);
+    slots[s].quantum = quantum[submit->level];
+    set_deadline(s, now + slots[s].quantum);
+}
+
+void stop_processes(){
+    // only the slots whose own quantum ran out are requeued, and only as many as there are
+    // jobs waiting to take their place. They are not stopped yet: the pick may hand them
+    // straight back a cpu, see stop_expired()
+    long now = get_time();
+    int waiting = queued;
+    count_expired = 0;
+    while (deadline_count > 0 && slots[deadline_heap[0]].deadline <= now)
+    {
+        if (waiting > 0) {
+            expired[count_expired++] = slots[deadline_heap[0]].job;
+            requeue_slot(deadline_heap[0]);
+            waiting--;
+        }
+        else{
+            renew_slot(deadline_heap[0]);
+        }
+    }
+}
+
+void stop_expired(){
+    // requeued jobs that did not get a slot back have to stop now
+    for (int i = 0; i < count_expired; i++)
+    {
+        Submit *submit = expired[i];
+        if (slots[submit->last_slot].job != submit) {
+            kill(-submit->pid, SIGSTOP);
+            submit->stopped = 1;
+        }
+    }
+    count_expired = 0;
+}
+
+long running_remaining(Submit *job){
+    // like remaining(), but also counts the quantum in progress
+    long left = remaining(job) - (job_cpu(job) - job->slice_cpu);
+    return left > 0 ? left : 0;
+}
+
+int find_victim(Submit *arrival){
+    // slot whose job should make way for a new arrival right now, -1 to just queue it
+    if (!running || busy_slots < NCPU) {
+        return -1;
+    }
+    int victim = -1;
+    long longest = 0 , latest = 0;
+    if (policy == POLICY_MLFQ) {
+        // strict priority: the lowest-priority running job gives way to a strictly higher one
+        for (int s = 0; s < NCPU; s++)
+        {
+            if (slots[s].job->level > arrival->level && (victim == -1 || slots[s].job->level > slots[victim].job->level)) {
+                victim = s;
+            }
+        }
+    }
+    else if (policy == POLICY_SRTF) {
+        for (int s = 0; s < NCPU; s++)
+        {
+            long left = running_remaining(slots[s].job);
+            if (left > longest) {
+                longest = left;
+                victim = s;
+            }
+        }
+        if (longest <= remaining(arrival)) {
+            victim = -1;
+        }
+    }
+    else if (policy == POLICY_EDF) {
+        for (int s = 0; s < NCPU; s++)
+        {
+            if (victim == -1 || slots[s].job->deadline > latest) {
+                latest = slots[s].job->deadline;
+                victim = s;
+            }
+        }
+        if (latest <= arrival->deadline) {
+            victim = -1;
+        }
+    }
+    return victim;
+}
+
+bool admit(Submit *arrival){
+    // everything due no later than the new job, plus the job itself, has to fit on NCPU cpus in time
+    if (arrival->deadline == LONG_MAX) {
+        return true;
+    }
+    long work = remaining(arrival);
+    for (int s = 0; s < NCPU; s++)
+    {
+        if (slots[s].job != NULL && slots[s].job->deadline <= arrival->deadline) {
+            work += running_remaining(slots[s].job);
+        }
+        for (int i = 0; i < ready[s].count; i++)
+        {
+            Submit *job = ready_nth(&ready[s], i);
+            if (job->deadline <= arrival->deadline) {
+                work += remaining(job);
+            }
+        }
+    }
+    return get_time() + work / NCPU <= arrival->deadline;
+}
+
+Submit* find_job(int pgid){
+    for (int s = 0; s < NCPU; s++)
+    {
+        if (slots[s].job != NULL && slots[s].job->pid == pgid) {
+            return slots[s].job;
+        }
+    }
+    return find_queued(pgid);
+}
+
+void reap_children(){
+    // SIGCHLD only tells us something changed, so collect every exited child. We are a
+    // subreaper, so helpers a job leaves behind become our children too; a job is over once
+    // its whole process group is gone.
+    int status;
+    siginfo_t info;
+    struct rusage usage;
+    while (true) {
+        // peek first: a zombie still tells us its process group, a reaped child does not
+        info.si_pid = 0;
+        if (waitid(P_ALL, 0, &info, WEXITED | WNOHANG | WNOWAIT) == -1 || info.si_pid == 0) {
+            break;
+        }
+        int pid = info.si_pid;
+        int pgid = getpgid(pid);
+        wait4(pid, &status, 0, &usage);
+        Submit *submit = find_job(pgid);
+        if (submit == NULL) {
+            continue;   // left its job's group, nothing to account it to
+        }
+        add_usage(&submit->usage, &usage);
+        if (pid == submit->pid) {
+            submit->status = status;
+            submit->leader_done = 1;
+        }
+        if (!submit->leader_done || kill(-submit->pid, 0) == 0) {
+            continue;   // part of the job is still running and keeps its slot
+        }
+        int s = submit->last_slot;
+        if (s != -1 && slots[s].job == submit) {
+            submit->end_time = get_time();
+            observe_burst(submit->level, job_cpu(submit) - submit->slice_cpu, false);
+            release_slot(s);
+            finish_job(submit);
+        }
+        else{
+            // a job can also die while it sits stopped in the queue
+            submit->finished = 1;
+            submit->end_time = get_time();
+            submit->wait_time += submit->end_time - submit->enqueued_at;
+            if (!submit->start_flag) {
+                submit->start_time = submit->end_time;   // it never got a slot
+            }
+        }
+    }
+}
+
+void set_round_robin_timer() {
+    // a single timerfd is armed for whichever slot's quantum ends first
+    struct itimerspec val;
+    memset(&val, 0, sizeof(val));
+    if (deadline_count > 0) {
+        long earliest = slots[deadline_heap[0]].deadline;
+        val.it_value.tv_sec = earliest / NSEC_PER_SEC;
+        val.it_value.tv_nsec = earliest % NSEC_PER_SEC;
+    }
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &val, NULL) == -1) {
+        printf("Not able to set time\n");
+        exit(1);
+    }
+}
+
+void prewarm(char *command){
+    // start reading the executable into the page cache so its first dispatch does not wait on disk
+    if (strchr(command, '/') == NULL) {
+        return;
+    }
+    int file = open(command, O_RDONLY | O_CLOEXEC);
+    if (file != -1) {
+        posix_fadvise(file, 0, 0, POSIX_FADV_WILLNEED);
+        close(file);
+    }
+}
+
+typedef struct {
+    char **command , **envp;   // envp is ready to exec, see build_env()
+    char *cwd;
+    int gate , gate_out;   // both ends of the start gate
+    int exec_status;       // write end of the exec status pipe, closed by a successful exec
+} Launch;
+
+bool same_variable(char *a , char *b){
+    // NAME=... against NAME=..., only the names are compared
+    while (*a != '\0' && *a != '=' && *a == *b) {
+        a++;
+        b++;
+    }
+    return (*a == '=' || *a == '\0') && (*b == '=' || *b == '\0');
+}
+
+int launch_job(void *arg){
+    // runs in the scheduler's address space on its own stack until execvp replaces it, so it
+    // only reads its Launch block and makes system calls. It is parked on the gate until the
+    // job's first dispatch, and the scheduler sits in open_gate() while it execs.
+    Launch *launch = (Launch*)arg;
+    sigset_t empty;
+    sigemptyset(&empty);
+    sigprocmask(SIG_SETMASK, &empty, NULL);   // the blocked mask survives exec
+    setpgid(0, 0);   // the job and everything it starts are stopped and continued as one group
+    close(launch->gate_out);
+    signal(SIGPIPE, SIG_DFL);   // the scheduler ignores it, and an ignored signal stays ignored across exec
+    char go;
+    if (read(launch->gate, &go, 1) != 1) {
+        _exit(1);   // the scheduler went away before dispatching us
+    }
+    int err = 0;
+    if (launch->cwd[0] != '\0' && chdir(launch->cwd) == -1) {
+        err = errno;
+    }
+    else{
+        execvpe(launch->command[0], launch->command, launch->envp);
+        err = errno;
+    }
+    write(launch->exec_status, &err, sizeof(err));
+    _exit(127);
+}
+
+int count_strings(char **strings){
+    int n = 0;
+    while (strings[n] != NULL) {
+        n++;
+    }
+    return n;
+}
+
+void build_env(char **envp , char **env){
+    // our environment with the submitted variables added or replaced
+    int n = 0 , added = count_strings(env);
+    for (int i = 0; environ[i] != NULL; i++)
+    {
+        bool replaced = false;
+        for (int j = 0; j < added && !replaced; j++)
+        {
+            replaced = same_variable(environ[i], env[j]);
+        }
+        if (!replaced) {
+            envp[n++] = environ[i];
+        }
+    }
+    for (int j = 0; j < added; j++)
+    {
+        envp[n++] = env[j];
+    }
+    envp[n] = NULL;
+}
+
+void spawn_job(Submit *submit){
+    // clone() shares our memory instead of copying it like fork(), and the child waits on a
+    // gate before exec instead of being stopped somewhere inside the job
+    int gate[2] , status[2];
+    char path[4096];
+    job_path(submit, path, sizeof(path));
+    prewarm(path);
+    if (pipe2(gate, O_CLOEXEC) == -1 || pipe2(status, O_CLOEXEC) == -1) {
+        printf("Creating pipes failed.\n");
+        exit(1);
+    }
+    // envp sits just above the top of the child's stack, so the size of the submitted environment
+    // never eats into the stack and one free() releases both
+    int count_env = count_strings(environ) + count_strings(submit->env) + 1;
+    submit->stack = (char*)malloc(SPAWN_STACK + sizeof(char*) * count_env);
+    if (submit->stack == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    // the Launch block sits at the bottom of the child's stack, which grows down from the top
+    Launch *launch = (Launch*)submit->stack;
+    launch->command = submit->command;
+    launch->envp = (char**)(submit->stack + SPAWN_STACK);
+    build_env(launch->envp, submit->env);
+    launch->cwd = submit->cwd;
+    launch->gate = gate[0];
+    launch->gate_out = gate[1];
+    launch->exec_status = status[1];
+    int pid = clone(launch_job, submit->stack + SPAWN_STACK, CLONE_VM | SIGCHLD, launch);
+    if (pid < 0) {
+        printf("Forking child failed.\n");
+        exit(1);
+    } 
+    setpgid(pid, pid);   // also done by the child, whichever runs first wins
+    close(gate[0]);
+    close(status[1]);
+    submit->pid = pid;
+    submit->gate = gate[1];
+    submit->exec_status = status[0];
+}
+
+bool open_gate(Submit *submit){
+    // let the child exec and wait until it has: EOF on the status pipe means the exec worked.
+    // A failed exec sends errno first, and the child then still runs _exit() on the stack we
+    // share, so read on to EOF: its fds are only closed after it has left our address space.
+    int err , n;
+    char rest;
+    bool started = true;
+    if (write(submit->gate, "g", 1) != 1) {
+        // EPIPE: it was killed while parked and reap_children() has not seen it yet; it keeps the
+        // slot until then, like a job whose exec failed. Nothing runs on the stack any more.
+        printf("Command failed: %s: it died before it was dispatched\n", submit->command[0]);
+        started = false;
+    }
+    close(submit->gate);
+    submit->gate = -1;
+    if (started && read(submit->exec_status, &err, sizeof(err)) == sizeof(err)) {
+        printf("Command failed: %s: %s\n", submit->command[0], strerror(err));
+        started = false;
+        while ((n = read(submit->exec_status, &rest, 1)) > 0 || (n == -1 && errno == EINTR)) {
+        }
+    }
+    close(submit->exec_status);
+    free(submit->stack);
+    submit->stack = NULL;
+    return started;
+}
+
+void spawn_ahead(){
+    // only the first few jobs of each run queue get a process, a long backlog stays as records
+    for (int s = 0; s < NCPU; s++)
+    {
+        for (int i = 0; i < ready[s].count && i < lookahead; i++)
         {
-            if (queue[j].priority > queue[j + 1].priority) {
-                temp = queue[1];
-                queue[j] = queue [ j + 1];
-                queue[j + 1] = temp;
-                count++;;
+            Submit *submit = ready_nth(&ready[s], i);
+            if (submit->pid == 0) {
+                spawn_job(submit);
             }
-            j++;
-        }
-        if (count <= 0) {
-            break;
         }
     }
 }
 
-long get_time(){
-    struct timeval time, *address_time = &time;
-    if (gettimeofday(address_time, NULL) != 0) {
-        printf("Error in getting the time.\n");
-        exit(1);
+void round_robin(){
+    // hand every idle cpu the next job in the queue, each with a fresh quantum
+    for (int s = 0; s < NCPU && running; s++)
+    {
+        while (slots[s].job == NULL && !queue_empty()) {
+            Submit *submit = pick_next(s);
+            if (submit->finished) {
+                finish_job(submit);
+                continue;
+            }
+            if (submit->pid == 0) {
+                spawn_job(submit);   // stolen from beyond the lookahead window
+            }
+            pin_to_slot(submit, s);
+            if (submit->gate != -1) {
+                // first dispatch: the job starts running its own code right here
+                submit->start_flag = 1;
+                submit->start_time = get_time();
+                if (open_gate(submit)) {
+                    notify(submit, MSG_STARTED);
+                }
+            }
+            else if (submit->stopped) {
+                kill(-submit->pid, SIGCONT);
+                submit->stopped = 0;
+            }
+            submit->slice_cpu = job_cpu(submit);
+            submit->dispatch_time = get_time();
+            slots[s].job = submit;
+            slots[s].quantum = quantum[submit->level];
+            set_deadline(s, get_time() + slots[s].quantum);
+            busy_slots++;
+        }
+    }
+    if (queue_empty() && busy_slots == 0) {
+        running = false;
     }
-    long epoch_time = time.tv_sec * 1000;
-    return epoch_time + time.tv_usec / 1000;
+    spawn_ahead();
+    set_round_robin_timer();
 }
 
-void add_to_history(char *command, int pid, long start_time_ms, long end_time_ms , long wait_time) {
-    strcpy(history[count_history], command);
-    pid_history[count_history] = pid;
-    time_history[count_history][0] = start_time_ms;
-    time_history[count_history][1] = end_time_ms;
-    wait_history[count_history] = wait_time;
-    count_history++;
+void quantum_expired(){
+    uint64_t expirations;
+    read(timer_fd, &expirations, sizeof(expirations));
+    stop_processes();
+    round_robin();
+    stop_expired();
 }
 
-void display_history() {
-    printf("-------------------------------\n");
-    printf("\n Command History for Scheduler: \n");
-    printf("-------------------------------\n");
+void release_session(Session *session);
 
-    for (int i = 0; i < count_history; i++) {
-        printf("Command: %s\n", history[i]);
-        printf("PID: %d\n", pid_history[i]);
-        printf("Execution Time: %ld\n", time_history[i][1] - time_history[i][0]);
-        printf("Wait Time: %ld\n", wait_history[i]);
-        printf("-------------------------------\n");
+void sigusr_handler( int signum ){
+    if ( signum == SIGUSR1 ) 
+    {   // the old way to say "run", for every session at once
+        for (Session *session = sessions; session != NULL; session = session->next)
+        {
+            release_session(session);
+        }
+        return;
     }
+}
 
-    //calculating averages
-    long avg_waiting = 0 , avg_execution = 0;
-    for (int i = 0; i < count_history; i++)
-    {
-        avg_execution += time_history[i][1] - time_history[i][0];
-        avg_waiting += wait_history[i]; 
+
+void sigint_handler(int signum) { 
+    if (signum == SIGINT) {
+        printf("\n---------------------------------\n");
+        display_history();
+        save_estimates();
+        unlink(socket_path());
+        exit(0);
     }
-    avg_execution /= count_history;
-    avg_waiting /= count_history; 
-    printf("Average execution Time: %ld\n\n", avg_execution);
-    printf("Average Waiting Time: %ld\n", avg_waiting);
-    printf("-------------------------------\n");
 }
 
-int queue_empty(){
-    return front == rear;
-
+void handle_signals(){
+    struct signalfd_siginfo info;
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGCHLD) {
+            reap_children();
+            round_robin();
+        }
+        else if (info.ssi_signo == SIGUSR1) {
+            sigusr_handler(SIGUSR1);
+        }
+        else if (info.ssi_signo == SIGINT || info.ssi_signo == SIGTERM) {
+            sigint_handler(SIGINT);
+        }
+    }
 }
 
-void print_queue(){
-    printf("front: %d , rear: %d\n" ,front , rear );
-    for (int i = front; i < rear; i++)
+void setup_signal_handler() {
+    // the signals are only ever delivered through signal_fd, so nothing runs in handler context
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGUSR1);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1)
     {
-        printf("\npid: %d , Command_string : %s\n" , queue[i].pid , queue[i].command[0] );
+        printf("Error in blocking signals\n");
+        exit(1);
+    }
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd == -1)
+    {
+        printf("Error in creating signalfd\n");
+        exit(1);
+    }
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+        printf("Error in creating timerfd\n");
+        exit(1);
     }
-    
 }
 
-void add_waittime( ){
-    for (int i = front ; i < rear; i++)
+void place_job(Submit *submit);
+
+void queue_command(Session *session , SubmitRecord *record){
+    // the strings are copied once into a block that starts with the argv and env pointer
+    // arrays, so the job owns a single allocation and nothing is tokenised
+    char *strings = (char*)(record + 1);
+    size_t body = record->header.length - sizeof(SubmitRecord) , at = 0;
+    if (record->header.length < sizeof(SubmitRecord) || record->argc == 0
+        || 2 + (size_t)record->argc + record->envc > body) {   // every string takes at least its NUL
+        printf("Malformed submit.\n");
+        flush_acks(session);
+        reply(session, MSG_REFUSED, 0, 0, false);
+        return;
+    }
+    int count = 2 + record->argc + record->envc;   // cwd, group, argv, env
+    for (int i = 0; i < count; i++)
     {
-        queue[i].wait_time += TSLICE;
+        char *nul = at < body ? memchr(strings + at, '\0', body - at) : NULL;
+        if (nul == NULL) {
+            printf("Malformed submit.\n");
+            flush_acks(session);
+            reply(session, MSG_REFUSED, 0, 0, false);
+            return;
+        }
+        at = nul - strings + 1;
     }
-}
+    int pointers = record->argc + 1 + record->envc + 1;
+    char **block = (char**)malloc(sizeof(char*) * pointers + at);
+    if (block == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    char *next = (char*)(block + pointers);
+    memcpy(next, strings, at);
 
-void stop_processes(){
+    Submit *submit = new_submit();
+    submit->command = block;
+    submit->env = block + record->argc + 1;
+    submit->cwd = next;
+    next += strlen(next) + 1;
+    char *group = next;
+    next += strlen(next) + 1;
+    for (uint32_t i = 0; i < record->argc; i++)
+    {
+        submit->command[i] = next;
+        next += strlen(next) + 1;
+    }
+    submit->command[record->argc] = NULL;
+    for (uint32_t i = 0; i < record->envc; i++)
+    {
+        submit->env[i] = next;
+        next += strlen(next) + 1;
+    }
+    submit->env[record->envc] = NULL;
 
-    int status , i = 0;
-    while (i < cpu_counter) { 
-        int pid = queue[old_head].pid;
-        kill(pid, SIGSTOP);
-        //printf("stopping process with pid :%d\n" , pid );
+    submit->priority = record->priority;
+    submit->level = submit->priority - 1;
+    if (submit->level < 0) {
+        submit->level = 0;
+    }
+    if (submit->level >= LEVELS) {
+        submit->level = LEVELS - 1;
+    }
+    char path[4096];
+    job_path(submit, path, sizeof(path));
+    submit->vruntime = min_vruntime;   // new jobs start level with the queue, not at zero
+    submit->submit_time = get_time();
+    submit->last_slot = -1;
+    submit->estimate = lookup_estimate(path);
+    submit->deadline = record->deadline >= 0 ? submit->submit_time + record->deadline : LONG_MAX;
+    submit->pass = min_pass;   // like vruntime, newcomers start at the current front of the queue
+    if (group[0] != '\0') {
+        join_group(submit, group);
+    }
 
-        waitpid(pid, &status, WNOHANG);
+    if (policy == POLICY_EDF && !admit(submit)) {
+        if (reject_late) {
+            printf("Rejected %s: its deadline cannot be met with the current backlog.\n", submit->command[0]);
+            if (submit->group != NULL) {
+                leave_group(submit);
+            }
+            free_submit(submit);
+            flush_acks(session);
+            reply(session, MSG_REFUSED, 0, 0, false);
+            return;
+        }
+        printf("Warning: %s is likely to miss its deadline.\n", submit->command[0]);
+        submit->at_risk = 1;
+    }
 
-        if (!WIFEXITED(status)) {
-            queue[rear] = queue[old_head];
-            rear++;
+    submit->session = session;
+    submit->id = ++session->next_job;
+    // a session that is still running its last "run" takes new submits right away; the shell
+    // has to know, and one MSG_ACCEPTED only covers submits that were all treated alike
+    if (session->ack_count > 0 && session->ack_released != session->running) {
+        flush_acks(session);
+    }
+    if (session->ack_count++ == 0) {
+        session->ack_first = submit->id;
+        session->ack_released = session->running;
+    }
+    if (!session->running) {
+        // held back until this session says "run", other sessions are not affected
+        if (session->pending_tail != NULL) {
+            session->pending_tail->next_pending = submit;
         }
         else{
-            queue[old_head].end_time = get_time();
-            Submit submit = queue[old_head];
-            add_to_history(submit.command[0] , submit.pid , submit.start_time , submit.end_time , submit.wait_time);
-            sleep(1);
+            session->pending = submit;
         }
-        old_head++;
-        i++;    
+        session->pending_tail = submit;
+        return;
+    }
+    session->active++;
+    place_job(submit);
+    if (running && busy_slots < NCPU)
+    {
+        round_robin();
     }
-
 }
 
-void sigalrm_handler(int signum){
-    if (signum == SIGALRM) {
-        //printf("received sigalrm\n");
-        stop_processes();
-        return;
+void place_job(Submit *submit){
+    // no process yet: spawn_ahead() creates one once the job is close to the head of its queue
+    int victim = find_victim(submit);
+    if (victim != -1) {
+        // queue it on the slot it displaces so that slot picks it up next; a job that only
+        // just started keeps the cpu for min_run, so its quantum is cut short instead
+        ready_push(&ready[victim], submit);
+        long earliest = slots[victim].job->dispatch_time + min_run;
+        if (get_time() >= earliest) {
+            preempt_slot(victim);
+        }
+        else if (slots[victim].deadline > earliest) {
+            set_deadline(victim, earliest);
+            set_round_robin_timer();
+        }
     }
+    else{
+        ready_push(&ready[shortest_queue()], submit);
+    }
+    spawn_ahead();
 }
 
-void set_round_robin_timer() {
-    struct itimerval val;
-    struct sigaction act;
-    //doing signal masking
-    sigemptyset(&act.sa_mask);
-    act.sa_flags = SA_RESTART;
-    act.sa_handler = sigalrm_handler;
-    //what action will be taken on expiration of timer
-    if (sigaction(SIGALRM, &act, NULL) == -1) {
-        printf("sigaction not working\n");
+void add_to_epoll(int watch_fd){
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = watch_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, watch_fd, &ev) == -1) {
+        printf("Error in adding fd to epoll\n");
+        exit(1);
+    }
+}
 
+void open_socket(){
+    // shells connect here and keep the connection for their whole session
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path(), sizeof(addr.sun_path) - 1);
+    // one scheduler per socket, and two shells starting together may both launch one: whoever
+    // holds the lock next to the socket owns the path until it exits, the kernel drops the lock
+    // with it, so a socket left behind by a crash is safe to replace
+    char lock_path[sizeof(addr.sun_path) + 8];
+    snprintf(lock_path, sizeof(lock_path), "%s.lock", addr.sun_path);
+    int lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lock_fd == -1) {
+        printf("couldn't open %s\n", lock_path);
         exit(1);
     }
-    // setting up timer values
-    val.it_value.tv_sec = TSLICE / 1000;
-    val.it_value.tv_usec = (TSLICE % 1000) * 1000;
-    val.it_interval.tv_sec = 0;
-    val.it_interval.tv_usec = 0;
-    //creates and starts the timer
-    if (setitimer(ITIMER_REAL, &val, NULL) == -1) {
-        printf("Not able to set time\n");
+    if (flock(lock_fd, LOCK_EX | LOCK_NB) == -1) {
+        printf("A scheduler is already running on %s\n", addr.sun_path);
+        exit(0);
+    }
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(addr.sun_path);   // left behind by a scheduler that did not exit cleanly
+    if (listen_fd == -1 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(listen_fd, 16) == -1) {
+        printf("couldn't bind %s\n", addr.sun_path);
         exit(1);
     }
 }
 
-void round_robin(){
-    //sort_queue();
-    cpu_counter = 0;
-    old_head = front;
-    int pid ;
-
-    while (cpu_counter != NCPU && !queue_empty()) {
-        kill(queue[front].pid, SIGCONT);
-        //printf("continuing process with pid :%d\n" ,queue[front].pid );
-
-        if ( !queue[front].start_flag )
-        {
-            queue[front].start_flag = 1;
-            queue[front].start_time = get_time();
-        }
-        cpu_counter++;
-        front++;
+void release_session(Session *session){
+    // "run": everything the session submitted so far enters the run queues
+    while (session->pending != NULL) {
+        Submit *submit = session->pending;
+        session->pending = submit->next_pending;
+        session->active++;
+        place_job(submit);
     }
-
-    add_waittime();
-    sleep(1);
-    //printf("timer running\n");
-    set_round_robin_timer();
-    sleep(1);
-    
+    session->pending_tail = NULL;
+    session->running = session->active > 0;
+    running = true;
+    round_robin();
 }
 
-
-void sigusr_handler( int signum ){
-    if ( signum == SIGUSR1 ) 
-    {   while (!queue_empty())
-        {
-            round_robin();
+Session* find_session(int client){
+    for (Session *session = sessions; session != NULL; session = session->next)
+    {
+        if (session->client == client) {
+            return session;
         }
-        return;
     }
+    return NULL;
 }
 
+void open_session(int client){
+    Session *session = (Session*)calloc(1, sizeof(Session));
+    if (session == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    session->id = ++count_sessions;
+    session->client = client;
+    session->next = sessions;
+    sessions = session;
+    served = true;
+}
 
-void sigint_handler(int signum) { 
-    if (signum == SIGINT) {
-        printf("\n---------------------------------\n");
-        display_history();
-        exit(0);
+void close_session(Session *session){
+    // jobs it never ran are dropped; released ones finish, then the session goes with them
+    while (session->pending != NULL) {
+        Submit *submit = session->pending;
+        session->pending = submit->next_pending;
+        if (submit->group != NULL) {
+            leave_group(submit);
+        }
+        free_submit(submit);
     }
+    session->pending_tail = NULL;
+    free(session->outbox);
+    session->outbox = NULL;
+    session->outbox_count = 0;
+    session->client = -1;
+    session->active++;   // session_job_done() below frees it if nothing is left running
+    session_job_done(session);
 }
 
-void setup_signal_handler() {
-    struct sigaction sh_int, sh_usr1 , sh_stp;
-    memset(&sh_int, 0, sizeof(sh_int));
-    sh_int.sa_handler = sigint_handler; 
-    if (sigaction(SIGINT, &sh_int, NULL) == -1)
-    {
-        printf("Error in handling SIGINT\n");
+void handle_message(Session *session , MessageHeader *header){
+    if (header->type == MSG_RUN) {
+        release_session(session);
     }
-    memset(&sh_usr1, 0, sizeof(sh_usr1));
-    sh_usr1.sa_handler = sigusr_handler;
-    if (sigaction(SIGUSR1, &sh_usr1, NULL) == -1)
-    {
-        printf("Error in handling SIGUSR1\n");
+    else if (header->type == MSG_SUBMIT) {
+        queue_command(session, (SubmitRecord*)header);
     }
-    
-    struct sigaction sh_alarm;   
-    sh_alarm.sa_handler = sigalrm_handler;
-    if (sigaction(SIGALRM, &sh_alarm, NULL) != 0) {
-        printf("Signal handling for SIGALRM failed.\n");
-        exit(1);
+    else if (header->type == MSG_SUBSCRIBE && header->length >= sizeof(SubscribeRecord)) {
+        session->subscribed = true;
+        session->subscribed_all = ((SubscribeRecord*)header)->all != 0;
+    }
+    else{
+        printf("Unknown message of type %u.\n", header->type);
     }
 }
 
-char** break_spaces(char *str) {  
-    char **command;
-    char *sep = " \n";
-    command = (char**)malloc(sizeof(char*) * 100);
-    int len = 0;
-    if (command == NULL) {
+typedef struct Ring {
+    SubmitRing *shm;
+    int doorbell , client;   // eventfd the shell rings, and the connection that brought the ring
+    struct Ring *next;
+} Ring;
+Ring *rings = NULL;
+
+void attach_ring(int client , int memfd , int doorbell){
+    // touching a page past the end of a short memfd would SIGBUS the whole daemon, so the ring
+    // must be big enough and sealed against the shell shrinking it later
+    struct stat st;
+    int seals = fcntl(memfd, F_GET_SEALS);
+    if (fstat(memfd, &st) == -1 || st.st_size < (off_t)sizeof(SubmitRing) || seals == -1 || !(seals & F_SEAL_SHRINK)) {
+        printf("Refusing a submission ring that is too small or not sealed against shrinking.\n");
+        close(memfd);
+        close(doorbell);
+        return;
+    }
+    SubmitRing *shm = mmap(NULL, sizeof(SubmitRing), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    close(memfd);
+    if (shm == MAP_FAILED) {
+        printf("couldn't map submission ring\n");
+        close(doorbell);
+        return;
+    }
+    Ring *ring = (Ring*)malloc(sizeof(Ring));
+    if (ring == NULL) {
         printf("Memory allocation failed\n");
-        exit(1); 
+        exit(1);
     }
+    ring->shm = shm;
+    ring->doorbell = doorbell;
+    ring->client = client;
+    ring->next = rings;
+    rings = ring;
+    add_to_epoll(doorbell);
+}
 
-    int i = 0;
-    char *token = strtok(str,sep ); 
-    while (token != NULL) {
-        len = strlen(token);
-        command[i] = (char*)malloc( len + 1);
-        if (command[i] == NULL) {
-            printf("Memory allocation failed\n");
-            exit(1); 
+void drain_ring(Ring *ring){
+    // copy each record out first: the shell owns the memory and may reuse the slot right away
+    _Alignas(8) char message[RING_RECORD];
+    MessageHeader *header = (MessageHeader*)message;
+    uint32_t head = atomic_load_explicit(&ring->shm->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->shm->tail, memory_order_acquire);
+    while (head != tail) {
+        memcpy(message, ring->shm->records[head & (RING_SLOTS - 1)], RING_RECORD);
+        atomic_store_explicit(&ring->shm->head, ++head, memory_order_release);
+        if (header->length >= sizeof(MessageHeader) && header->length <= RING_RECORD) {
+            handle_message(find_session(ring->client), header);
+        }
+        if (head == tail) {
+            tail = atomic_load_explicit(&ring->shm->tail, memory_order_acquire);
         }
+    }
+    flush_acks(find_session(ring->client));
+}
 
-        strcpy(command[i], token);
-        token = strtok(NULL, sep);
-        i++;
+void drain_rings(){
+    for (Ring *ring = rings; ring != NULL; ring = ring->next)
+    {
+        drain_ring(ring);
     }
-    command[i] = NULL;
-    return command;
 }
 
-void queue_command( char* message){
-    char **command = break_spaces(message);
-    int i = 0 , j = 0;
-    while (command[i] != NULL)
+bool rings_sleep(bool sleeping){
+    // announce we are going to block; the fence pairs with the shell's fence between publishing
+    // a record and checking this flag, so one of the two always sees the other. Returns true if
+    // records are already waiting, in which case we must not block.
+    bool pending = false;
+    for (Ring *ring = rings; ring != NULL; ring = ring->next)
     {
-        i++;
+        atomic_store_explicit(&ring->shm->sleeping, sleeping, memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+    for (Ring *ring = rings; ring != NULL && sleeping; ring = ring->next)
+    {
+        pending |= atomic_load_explicit(&ring->shm->tail, memory_order_relaxed) != atomic_load_explicit(&ring->shm->head, memory_order_relaxed);
     }
+    return pending;
+}
 
-    Submit submit;
-    submit.command = (char**)malloc(sizeof(char*));
-    submit.command[0] = (char*)malloc(sizeof(char)*100);
-    submit.command[0] = command[1];
-    if (i == 3)
+Ring* find_doorbell(int doorbell){
+    for (Ring *ring = rings; ring != NULL; ring = ring->next)
     {
-        submit.priority = atoi(command[2]);
+        if (ring->doorbell == doorbell) {
+            return ring;
+        }
     }
-    else{
-        submit.priority = 1;
+    return NULL;
+}
+
+void detach_rings(int client){
+    // the shell is gone, take what it managed to publish and drop its ring
+    Ring **link = &rings;
+    while (*link != NULL) {
+        Ring *ring = *link;
+        if (ring->client != client) {
+            link = &ring->next;
+            continue;
+        }
+        drain_ring(ring);
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, ring->doorbell, NULL);
+        close(ring->doorbell);
+        munmap(ring->shm, sizeof(SubmitRing));
+        *link = ring->next;
+        free(ring);
     }
-    submit.start_time = 0;
-    submit.end_time = 0;
-    submit.wait_time = 0;
-    submit.start_flag = 0;
-    queue[rear] = submit;
+}
 
-    int pid = fork();
-    if (pid < 0) {
-        printf("Forking child failed.\n");
-        exit(1);
-    } 
-    else if (pid == 0) {
-        execvp( submit.command[0] , submit.command );
-        printf("Command failed.\n");
-        exit(1);
+void accept_clients(){
+    int client;
+    while ((client = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+        add_to_epoll(client);
+        open_session(client);
+    }
+}
 
-    } else {
-        kill(pid, SIGSTOP);
-        queue[rear].pid = pid;
-        //add_to_history( queue[rear].command[0] , queue[rear].pid , get_time(), 0);        
-        rear++;
-    }   
-    
+void read_client(int client){
+    // one packet is one write by the shell and holds one or more messages back to back;
+    // a MSG_RING comes with the ring's memfd and doorbell attached
+    static _Alignas(8) char packet[MAX_PACKET];
+    char control[CMSG_SPACE(sizeof(int) * 2)];
+    struct iovec iov = { packet, MAX_PACKET };
+    struct msghdr msg;
+    int n;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    while ((n = recvmsg(client, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC)) > 0) {
+        int fds[2] , count_fds = 0;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            count_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * count_fds);
+        }
+        for (int at = 0; at + (int)sizeof(MessageHeader) <= n; )
+        {
+            MessageHeader *header = (MessageHeader*)(packet + at);
+            if (header->length < sizeof(MessageHeader) || header->length > (uint32_t)(n - at)) {
+                printf("Malformed message, dropping the rest of the packet.\n");
+                break;
+            }
+            if (header->type == MSG_RING && count_fds == 2) {
+                attach_ring(client, fds[0], fds[1]);
+                count_fds = 0;
+            }
+            else{
+                handle_message(find_session(client), header);
+            }
+            at += MESSAGE_ALIGN(header->length);
+        }
+        flush_acks(find_session(client));
+        for (int i = 0; i < count_fds; i++)
+        {
+            close(fds[i]);
+        }
+        msg.msg_controllen = sizeof(control);
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        detach_rings(client);
+        close_session(find_session(client));
+        // children still parked on their start gate hold copies of this fd until they exec,
+        // so closing it alone would not take it out of the epoll set
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client, NULL);
+        close(client);
+    }
 }
 
-void read_pipe(){
-    const char* pipename = "/tmp/simple__scheduler_fifo_";
-    fd = open(pipename, O_RDONLY);
-    // if (fd == -1) {
-    //     printf("couldn't open fd\n");
-    //     exit(1);
-    // }
-    char command[256];
+void event_loop(){
+    struct epoll_event events[MAX_EVENTS];
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        printf("Error in creating epoll\n");
+        exit(1);
+    }
+    add_to_epoll(signal_fd);
+    add_to_epoll(timer_fd);
+    add_to_epoll(listen_fd);
 
-    if (read(fd, command, sizeof(command)) > 0) {
-        queue_command( command );
+    while (true)
+    {
+        if (rings_sleep(true)) {
+            rings_sleep(false);
+            drain_rings();
+            continue;
+        }
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        rings_sleep(false);
+        drain_rings();
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("Error in epoll_wait\n");
+            exit(1);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            // reap first, so an expired quantum below never dispatches a job that already died
+            if (events[i].data.fd == signal_fd) {
+                handle_signals();
+            }
+        }
+        for (int i = 0; i < n; i++)
+        {
+            if (events[i].data.fd == signal_fd) {
+                continue;
+            }
+            else if (events[i].data.fd == timer_fd) {
+                quantum_expired();
+            }
+            else if (events[i].data.fd == listen_fd) {
+                accept_clients();
+            }
+            else if (find_doorbell(events[i].data.fd) != NULL) {
+                uint64_t rung;
+                read(events[i].data.fd, &rung, sizeof(rung));   // already drained above
+            }
+            else{
+                Session *session = find_session(events[i].data.fd);
+                if (session != NULL && (events[i].events & EPOLLOUT)) {
+                    flush_outbox(session);
+                }
+                if (events[i].events & ~EPOLLOUT) {
+                    read_client(events[i].data.fd);
+                }
+            }
+        }
+        if (!keep_alive && served && sessions == NULL && queue_empty() && busy_slots == 0) {
+            // the last shell has left and its jobs are done
+            sigint_handler(SIGINT);
+        }
     }
-    close(fd);
 }
 
 char* Input(){   // to take input from user , returns the string entered
@@ -352,17 +2120,162 @@ char* Input(){   // to take input from user , returns the string entered
     return input_str;
 }
 
-int main(int argc, char const *argv[])
+void parse_quanta(char *list){
+    // -q 10,20,50,100 gives priorities 1..4 their own slice, a shorter list repeats its last value
+    char *end = list;
+    for (int l = 0; l < LEVELS; l++)
+    {
+        if (*end != '\0') {
+            quantum[l] = parse_duration(end, &end);
+            if (*end == ',') {
+                end++;
+            }
+        }
+        else{
+            quantum[l] = quantum[l - 1];
+        }
+        if (quantum[l] <= 0) {
+            printf("Invalid quantum list: %s\n", list);
+            exit(1);
+        }
+    }
+}
+
+void usage(char *name){
+    printf("Usage: %s NCPU TSLICE [-p rr|mlfq|cfs|srtf|edf|lottery|stride] [-q q1,q2,q3,q4] [-a min,max] [-R] [-k] [-m min_run] [-A age] [-L lookahead]\n", name);
+    exit(1);
+}
+
+void parse_options(int argc, char *argv[]){
+    int opt;
+    char *quanta = NULL , *end;
+    while ((opt = getopt(argc, argv, "p:q:a:Rkm:A:L:")) != -1) {
+        switch (opt) {
+        case 'p':
+            if (!strcmp(optarg, "rr")) {
+                policy = POLICY_RR;
+            }
+            else if (!strcmp(optarg, "mlfq")) {
+                policy = POLICY_MLFQ;
+            }
+            else if (!strcmp(optarg, "cfs")) {
+                policy = POLICY_CFS;
+            }
+            else if (!strcmp(optarg, "srtf")) {
+                policy = POLICY_SRTF;
+            }
+            else if (!strcmp(optarg, "edf")) {
+                policy = POLICY_EDF;
+            }
+            else if (!strcmp(optarg, "lottery")) {
+                policy = POLICY_LOTTERY;
+            }
+            else if (!strcmp(optarg, "stride")) {
+                policy = POLICY_STRIDE;
+            }
+            else{
+                usage(argv[0]);
+            }
+            break;
+        case 'q':
+            quanta = optarg;
+            break;
+        case 'R':
+            reject_late = true;
+            break;
+        case 'k':
+            keep_alive = true;
+            break;
+        case 'L':
+            lookahead = atoi(optarg);
+            if (lookahead < 1) {
+                usage(argv[0]);
+            }
+            break;
+        case 'A':
+            // -A 100ms: a job waiting that long in an mlfq level is treated as one level higher
+            age_interval = parse_duration(optarg, &end);
+            if (age_interval <= 0 || *end != '\0') {
+                usage(argv[0]);
+            }
+            break;
+        case 'm':
+            min_run = parse_duration(optarg, &end);
+            if (min_run < 0 || *end != '\0') {
+                usage(argv[0]);
+            }
+            break;
+        case 'a':
+            // -a 1ms,200ms: retune each level's quantum from observed bursts within these bounds
+            adaptive = true;
+            quantum_min = parse_duration(optarg, &end);
+            quantum_max = *end == ',' ? parse_duration(end + 1, &end) : 0;
+            if (quantum_min <= 0 || quantum_max < quantum_min || *end != '\0') {
+                usage(argv[0]);
+            }
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2) {
+        printf("NCPU and TSLICE not entered!\n");
+        exit(1);
+    }
+    NCPU = strtol(argv[optind], &end, 10);
+    if (NCPU < 1 || *end != '\0') {
+        printf("Invalid NCPU: %s\n", argv[optind]);
+        exit(1);
+    }
+    TSLICE = parse_duration(argv[optind + 1], &end);
+    if (TSLICE <= 0 || *end != '\0') {
+        printf("Invalid TSLICE: %s\n", argv[optind + 1]);
+        exit(1);
+    }
+    for (int l = 0; l < LEVELS; l++)
+    {
+        quantum[l] = TSLICE;
+    }
+    if (quanta != NULL) {
+        parse_quanta(quanta);
+    }
+}
+
+int main(int argc, char *argv[])
 {
     //printf("Round Robin started\n");
     setup_signal_handler();
-    NCPU = atoi(argv[1]);
-    TSLICE = atoi(argv[2]);
-
-    while (true)
+    signal(SIGPIPE, SIG_IGN);   // a write to a dead job's gate or a gone shell must not kill us
+    parse_options(argc, argv);
+    prctl(PR_SET_CHILD_SUBREAPER, 1);   // orphaned helpers of a job are reparented to us
+    load_estimates();
+    srandom(getpid() ^ get_time());
+    slots = (Slot*)malloc(sizeof(Slot) * NCPU);
+    ready = (Ready*)calloc(NCPU, sizeof(Ready));
+    deadline_heap = (int*)malloc(sizeof(int) * NCPU);
+    expired = (Submit**)malloc(sizeof(Submit*) * NCPU);
+    if (slots == NULL || ready == NULL || deadline_heap == NULL || expired == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    // slot s is bound to the s-th core we are allowed to use, wrapping around
+    cpu_set_t allowed;
+    int cpus[CPU_SETSIZE] , count_cpus = 0;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    for (int c = 0; c < CPU_SETSIZE; c++)
     {
-        read_pipe();
-
+        if (CPU_ISSET(c, &allowed)) {
+            cpus[count_cpus++] = c;
+        }
+    }
+    for (int s = 0; s < NCPU; s++)
+    {
+        slots[s].job = NULL;
+        slots[s].heap_pos = -1;
+        slots[s].cpu = cpus[s % count_cpus];
     }
+    open_socket();
+
+    event_loop();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef SIMPLE_SCHEDULER_H
+#define SIMPLE_SCHEDULER_H
+
+// shared by simple_shell.c and Simple_Scheduler.c
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define SOCKET_PATH "/tmp/simple__scheduler_socket_"
+#define SOCKET_ENV "SIMPLE_SCHEDULER_SOCKET"   // overrides SOCKET_PATH, e.g. one scheduler per user
+
+static inline const char* socket_path(){
+    const char *path = getenv(SOCKET_ENV);
+    return path != NULL && path[0] != '\0' ? path : SOCKET_PATH;
+}
+
+#define NSEC_PER_MSEC 1000000L
+#define NSEC_PER_SEC 1000000000L
+
+static inline long parse_duration(char *str , char **end){
+    // "250us", "2ms", "1s" or "500ns"; a bare number is milliseconds as before
+    double value = strtod(str, end);
+    long scale = NSEC_PER_MSEC;
+    if (!strncmp(*end, "ns", 2)) {
+        scale = 1;
+        *end += 2;
+    }
+    else if (!strncmp(*end, "us", 2)) {
+        scale = 1000;
+        *end += 2;
+    }
+    else if (!strncmp(*end, "ms", 2)) {
+        *end += 2;
+    }
+    else if (**end == 's') {
+        scale = NSEC_PER_SEC;
+        *end += 1;
+    }
+    return (long)(value * scale);
+}
+
+// shells keep one SOCK_SEQPACKET connection open; every packet carries one or more messages
+// back to back, so a script's submits go out in one write
+#define MAX_PACKET 65536
+
+// every message starts with this header; the next one starts at the following multiple of 8
+enum { MSG_RUN = 1 , MSG_SUBMIT , MSG_RING , MSG_SUBSCRIBE ,
+       MSG_ACCEPTED , MSG_REFUSED , MSG_STARTED , MSG_EXITED };   // the last four are replies
+
+typedef struct {
+    uint32_t length;   // of the whole message, this header included, before padding
+    uint32_t type;
+} MessageHeader;
+
+#define MESSAGE_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+typedef struct {
+    MessageHeader header;   // MSG_SUBMIT
+    int64_t deadline;       // ns after arrival, -1 for none
+    int32_t priority;       // 1..4
+    uint32_t argc , envc;
+    // then NUL terminated strings: cwd ("" to inherit the scheduler's), group ("" for none),
+    // argc arguments starting with the program, envc NAME=VALUE pairs added to the environment
+} SubmitRecord;
+
+typedef struct {
+    MessageHeader header;   // MSG_SUBSCRIBE
+    uint32_t all;           // 0: events for this session's jobs, 1: for every session's
+} SubscribeRecord;
+
+// every MSG_SUBMIT is answered, in order, by MSG_ACCEPTED or MSG_REFUSED; consecutive accepted
+// submits share one MSG_ACCEPTED. Subscribed sessions also get MSG_STARTED and MSG_EXITED.
+typedef struct {
+    MessageHeader header;
+    uint32_t session , job;   // job ids count up from 1 in each session, 0 in MSG_REFUSED
+    uint32_t count;           // MSG_ACCEPTED: jobs job .. job + count - 1
+    int32_t pid;              // MSG_STARTED, MSG_EXITED: also the job's process group
+    int32_t status;           // MSG_EXITED: wait status of the job's first process
+    uint32_t released;        // MSG_ACCEPTED: 1 if the jobs were queued at once because the session's
+                              // last "run" is still going, 0 if they wait for the next "run"
+    int64_t runtime , wait;   // MSG_EXITED: ns from first dispatch to exit, ns spent queued
+} JobEvent;
+
+// optional fast path: the shell maps a single-producer/single-consumer ring of fixed-size
+// records and hands the memfd and an eventfd doorbell over in a MSG_RING (SCM_RIGHTS)
+#define RING_SLOTS 1024    // power of two
+#define RING_RECORD 256    // one message per record, longer ones go over the socket
+
+typedef struct {
+    _Alignas(64) _Atomic uint32_t head;   // next record the scheduler reads, only it writes this
+    _Alignas(64) _Atomic uint32_t tail;   // next record the shell fills, only it writes this
+    _Alignas(64) _Atomic int sleeping;    // scheduler is about to block in epoll, ring the doorbell
+    _Alignas(8) char records[RING_SLOTS][RING_RECORD];
+} SubmitRing;
+
+#endif
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include<stdio.h>
 #include<string.h>
 #include<stdlib.h>
@@ -11,6 +12,14 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include "simple_scheduler.h"
+
+#define MAX_LINE 4096   // longest command line the shell reads, submit lines included
 
 long get_time(){
     struct timeval time, *address_time = &time;
@@ -23,12 +32,36 @@ long get_time(){
 }
 
 bool and_flag = false , flag_for_Input = true , submit_flag = false;
-char history[100][100] , message_str[256];
+char history[100][256] , message_str[MAX_LINE];
 long time_history[100][2],start_time;
-int count_history = 0 , ncpu , tslice , fd , scheduler_pid  , pipe_fd , pid_history[100],  child_pid , fd;
+char *tslice_str;
+int count_history = 0 , ncpu , fd , scheduler_pid  , pipe_fd , pid_history[100],  child_pid , fd;
+int job_history[100];   // job id of a submit line, 0 for everything else
+int scheduler_argc;
+char **scheduler_argv;   // extra options after NCPU and TSLICE are handed to the scheduler as-is
+int scheduler_fd = -1;   // our connection to the scheduler, kept open for the whole session
+_Alignas(8) char batch[MAX_PACKET];  // messages waiting to go out together in one packet
+int batch_len = 0;
+SubmitRing *ring = NULL;   // shared with the scheduler when SIMPLE_SCHEDULER_RING is set
+int ring_doorbell = -1;
+
+enum { JOB_UNKNOWN , JOB_QUEUED , JOB_STARTED , JOB_EXITED };
+typedef struct {
+    int state;                    // advanced by the scheduler's replies and events
+    int pid , status , history;   // history: its line in the history, -1 for script submits
+    long runtime , wait;          // ns
+} ShellJob;
+ShellJob *jobs = NULL;   // indexed by job id
+int jobs_capacity = 0 , last_job = 0 , released_job = 0 , session_id = 0;
+
+// what each outstanding reply answers, in the order they were sent: a submit's history line
+// (-1 for script submits) or RUN_MARKER, which releases every job acknowledged before it
+#define RUN_MARKER -2
+int *awaiting = NULL;
+int awaiting_head = 0 , awaiting_count = 0 , awaiting_capacity = 0;
 
 int add_to_history(char *command, int pid, long start_time_ms, long end_time_ms, int count_history) {
-    strcpy(history[count_history], command);
+    snprintf(history[count_history], sizeof(history[count_history]), "%s", command);
     pid_history[count_history] = pid;
     time_history[count_history][0] = start_time_ms;
     time_history[count_history][1] = end_time_ms;
@@ -42,19 +75,27 @@ void display_history() {
 
     for (int i = 0; i < count_history; i++) {
         printf("Command: %s\n", history[i]);
+        if (job_history[i] != 0) {
+            printf("Job: %d.%d\n", session_id, job_history[i]);
+        }
         printf("PID: %d\n", pid_history[i]);
         printf("Start_Time: %ld\n", time_history[i][0]);
-        printf("End_Time: %ld\n", time_history[i][1]);
+        if (time_history[i][1] == 0) {
+            printf("End_Time: not finished\n");
+        }
+        else{
+            printf("End_Time: %ld\n", time_history[i][1]);
+        }
         printf("-------------------------------\n");
     }
 }
 
 void signal_handler(int signum) { 
     if (signum == SIGINT) {
+        // the scheduler may be serving other shells too; it exits by itself once they are all
+        // gone and the last job is done, and prints its history then
         printf("\n---------------------------------\n");
         display_history();
-        sleep(1);
-        kill( scheduler_pid , SIGINT );
         exit(0);
     }
     
@@ -260,13 +301,13 @@ bool check_for_pipes(char* str) {
 }
 
 char* Input(){   // to take input from user , returns the string entered
-    char *input_str = (char*)malloc(100);
+    char *input_str = (char*)malloc(MAX_LINE);
     if (input_str == NULL) {
         printf("Memory allocation failed\n");
         exit(1); 
     }
     flag_for_Input = false;
-    fgets(input_str ,100, stdin);
+    fgets(input_str ,MAX_LINE, stdin);
     
     if (strlen(input_str) != 0 && input_str[0] != '\n' && input_str[0] != ' ')
     {   
@@ -287,6 +328,424 @@ bool check_and(char* str){
     
 }
 
+bool connect_scheduler(int attempts){
+    // a scheduler we only just started needs a moment to bind its socket
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path(), sizeof(addr.sun_path) - 1);
+    for (int attempt = 0; attempt < attempts; attempt++)
+    {
+        scheduler_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (scheduler_fd == -1) {
+            printf("couldn't create socket\n");
+            exit(1);
+        }
+        if (connect(scheduler_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+            return true;
+        }
+        close(scheduler_fd);
+        usleep(10000);
+    }
+    return false;
+}
+
+void attach_ring(){
+    // hand the scheduler a shared ring and its doorbell; from then on every message goes through it
+    int memfd = memfd_create("simple_scheduler_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    ring_doorbell = eventfd(0, EFD_CLOEXEC);
+    // the scheduler only maps a ring that can no longer shrink under it
+    if (memfd == -1 || ring_doorbell == -1 || ftruncate(memfd, sizeof(SubmitRing)) == -1
+        || fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) == -1) {
+        printf("couldn't create submission ring\n");
+        exit(1);
+    }
+    ring = mmap(NULL, sizeof(SubmitRing), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (ring == MAP_FAILED) {
+        printf("couldn't map submission ring\n");
+        exit(1);
+    }
+    int fds[2] = { memfd, ring_doorbell };
+    char control[CMSG_SPACE(sizeof(fds))];
+    MessageHeader header = { sizeof(MessageHeader), MSG_RING };
+    struct iovec iov = { &header, sizeof(header) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    if (sendmsg(scheduler_fd, &msg, 0) == -1) {
+        printf("couldn't send submission ring\n");
+        exit(1);
+    }
+    close(memfd);
+}
+
+void ring_doorbell_if_asleep(){
+    // pairs with the scheduler's fence between raising its sleeping flag and checking the ring
+    uint64_t one = 1;
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->sleeping, memory_order_relaxed)) {
+        write(ring_doorbell, &one, sizeof(one));
+    }
+}
+
+void ring_wait(uint32_t free_records){
+    // the scheduler is behind, make sure it is awake and give it time to catch up
+    uint64_t one = 1;
+    while (atomic_load_explicit(&ring->tail, memory_order_relaxed) - atomic_load_explicit(&ring->head, memory_order_acquire) > RING_SLOTS - free_records) {
+        write(ring_doorbell, &one, sizeof(one));
+        usleep(100);
+    }
+}
+
+void ring_push(void *message , int len){
+    // single producer: only we move tail, and a record is ours once head has passed it
+    ring_wait(1);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    memcpy(ring->records[tail & (RING_SLOTS - 1)], message, len);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+void flush_batch(){
+    if (ring != NULL) {
+        ring_doorbell_if_asleep();
+        return;
+    }
+    if (batch_len > 0 && send(scheduler_fd, batch, batch_len, 0) == -1) {
+        printf("Sending to the scheduler failed.\n");
+    }
+    batch_len = 0;
+}
+
+void queue_message(void *message , int len){
+    // collected until flush_batch(), so a script full of submits costs one write;
+    // each message starts on a multiple of 8 so the scheduler can read the records in place
+    if (ring != NULL && len <= RING_RECORD) {
+        ring_push(message, len);
+        return;
+    }
+    if (ring != NULL) {
+        // too big for a record: let the ring empty first so it cannot overtake earlier submits
+        ring_wait(RING_SLOTS);
+        if (send(scheduler_fd, message, len, 0) == -1) {
+            printf("Sending to the scheduler failed.\n");
+        }
+        return;
+    }
+    if (batch_len + MESSAGE_ALIGN(len) > MAX_PACKET) {
+        flush_batch();
+    }
+    memcpy(batch + batch_len, message, len);
+    memset(batch + batch_len + len, 0, MESSAGE_ALIGN(len) - len);
+    batch_len += MESSAGE_ALIGN(len);
+}
+
+void expect_reply(int what){
+    if (awaiting_head + awaiting_count == awaiting_capacity) {
+        if (awaiting_head > 0) {
+            memmove(awaiting, awaiting + awaiting_head, sizeof(int) * awaiting_count);
+            awaiting_head = 0;
+        }
+        else{
+            awaiting_capacity = awaiting_capacity ? awaiting_capacity * 2 : 64;
+            awaiting = (int*)realloc(awaiting, sizeof(int) * awaiting_capacity);
+            if (awaiting == NULL) {
+                printf("Memory allocation failed\n");
+                exit(1);
+            }
+        }
+    }
+    awaiting[awaiting_head + awaiting_count++] = what;
+}
+
+void settle_runs(){
+    // a run covers exactly the submits sent before it, and those are acknowledged by now
+    while (awaiting_count > 0 && awaiting[awaiting_head] == RUN_MARKER) {
+        awaiting_head++;
+        awaiting_count--;
+        released_job = last_job;
+    }
+}
+
+int next_reply(){
+    settle_runs();
+    if (awaiting_count == 0) {
+        return -1;
+    }
+    awaiting_count--;
+    return awaiting[awaiting_head++];
+}
+
+void queue_run(){
+    MessageHeader header = { sizeof(MessageHeader), MSG_RUN };
+    queue_message(&header, sizeof(header));
+    expect_reply(RUN_MARKER);
+    settle_runs();
+}
+
+bool put_string(char *record , int *len , const char *str){
+    int size = strlen(str) + 1;
+    if (*len + size > MAX_PACKET) {
+        return false;
+    }
+    memcpy(record + *len, str, size);
+    *len += size;
+    return true;
+}
+
+bool queue_submit(char *line , int history){
+    // submit [-p priority] [-d deadline] [-g group] [-e NAME[=VALUE]]... program [args...]
+    // -e NAME alone forwards the variable's value from this shell's environment
+    static _Alignas(8) char record_buf[MAX_PACKET];
+    static char copy[MAX_LINE] , pair[MAX_PACKET];
+    char *words[MAX_LINE / 2 + 1] , *env[MAX_LINE / 2 + 1] , *group = "" , *end , cwd[4096];
+    int count_words = 0 , count_env = 0 , i = 1 , len = sizeof(SubmitRecord);
+    SubmitRecord *record = (SubmitRecord*)record_buf;
+
+    snprintf(copy, sizeof(copy), "%s", line);
+    for (char *word = strtok(copy, " \t\r\n"); word != NULL; word = strtok(NULL, " \t\r\n"))
+    {
+        words[count_words++] = word;
+    }
+    memset(record, 0, sizeof(SubmitRecord));
+    record->header.type = MSG_SUBMIT;
+    record->deadline = -1;
+    record->priority = 1;
+    for (; i + 1 < count_words && words[i][0] == '-' && words[i][2] == '\0'; i += 2)
+    {
+        if (words[i][1] == 'p') {
+            record->priority = atoi(words[i + 1]);
+        }
+        else if (words[i][1] == 'd') {
+            record->deadline = parse_duration(words[i + 1], &end);
+            if (*end != '\0' || record->deadline < 0) {
+                printf("Invalid deadline %s.\n", words[i + 1]);
+                return false;
+            }
+        }
+        else if (words[i][1] == 'g') {
+            group = words[i + 1];
+        }
+        else if (words[i][1] == 'e') {
+            env[count_env++] = words[i + 1];
+        }
+        else{
+            printf("Unknown submit option %s.\n", words[i]);
+            return false;
+        }
+    }
+    if (i >= count_words) {
+        printf("Usage: submit [-p priority] [-d deadline] [-g group] [-e NAME[=VALUE]]... program [args...]\n");
+        return false;
+    }
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        cwd[0] = '\0';
+    }
+    bool fits = put_string(record_buf, &len, cwd) && put_string(record_buf, &len, group);
+    for (; fits && i < count_words; i++)
+    {
+        fits = put_string(record_buf, &len, words[i]);
+        record->argc++;
+    }
+    for (int j = 0; fits && j < count_env; j++)
+    {
+        char *value = getenv(env[j]);
+        if (strchr(env[j], '=') != NULL) {
+            fits = put_string(record_buf, &len, env[j]);
+        }
+        else if (value != NULL) {
+            snprintf(pair, sizeof(pair), "%s=%s", env[j], value);
+            fits = strlen(pair) == strlen(env[j]) + 1 + strlen(value) && put_string(record_buf, &len, pair);
+        }
+        else{
+            continue;   // unset here, so it stays unset for the job
+        }
+        record->envc++;
+    }
+    if (!fits) {
+        printf("Command too long.\n");
+        return false;
+    }
+    record->header.length = len;
+    queue_message(record, len);
+    expect_reply(history);
+    return true;
+}
+
+ShellJob* find_job(int id){
+    if (id >= jobs_capacity) {
+        int capacity = jobs_capacity ? jobs_capacity : 64;
+        while (capacity <= id) {
+            capacity *= 2;
+        }
+        jobs = (ShellJob*)realloc(jobs, sizeof(ShellJob) * capacity);
+        if (jobs == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        memset(jobs + jobs_capacity, 0, sizeof(ShellJob) * (capacity - jobs_capacity));
+        jobs_capacity = capacity;
+    }
+    return &jobs[id];
+}
+
+void handle_event(JobEvent *event){
+    // a job may report STARTED before its submit is acknowledged, acks are sent per packet
+    ShellJob *job = find_job(event->job);
+    if (event->header.type == MSG_ACCEPTED) {
+        session_id = event->session;
+        for (uint32_t i = 0; i < event->count; i++)
+        {
+            int id = event->job + i , h = next_reply();
+            job = find_job(id);
+            job->history = h;
+            if (job->state == JOB_UNKNOWN) {
+                job->state = JOB_QUEUED;
+            }
+            if (id > last_job) {
+                last_job = id;
+            }
+            if (event->released && id > released_job) {
+                released_job = id;   // submitted while an earlier run was still going
+            }
+            if (h >= 0) {
+                job_history[h] = id;
+                pid_history[h] = job->pid;
+                if (job->state == JOB_EXITED) {
+                    time_history[h][1] = get_time();
+                }
+                printf("Submitted job %d.%d\n", session_id, id);
+            }
+        }
+    }
+    else if (event->header.type == MSG_REFUSED) {
+        next_reply();
+        printf("The scheduler refused a submit.\n");
+    }
+    else if (event->header.type == MSG_STARTED || event->header.type == MSG_EXITED) {
+        job->pid = event->pid;
+        job->state = event->header.type == MSG_STARTED ? JOB_STARTED : JOB_EXITED;
+        job->status = event->status;
+        job->runtime = event->runtime;
+        job->wait = event->wait;
+        if (job->history >= 0 && job_history[job->history] == (int)event->job) {
+            pid_history[job->history] = job->pid;
+            if (job->state == JOB_EXITED) {
+                time_history[job->history][1] = get_time();
+            }
+        }
+    }
+    settle_runs();
+}
+
+bool read_events(bool block){
+    // returns false once the scheduler has gone away
+    static _Alignas(8) char packet[MAX_PACKET];
+    int n;
+    while ((n = recv(scheduler_fd, packet, sizeof(packet), block ? 0 : MSG_DONTWAIT)) > 0) {
+        for (int at = 0; at + (int)sizeof(JobEvent) <= n; at += MESSAGE_ALIGN(sizeof(JobEvent)))
+        {
+            handle_event((JobEvent*)(packet + at));
+        }
+        block = false;   // got something, take whatever else is already there and return
+    }
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return true;
+    }
+    if (scheduler_fd != -1) {
+        printf("The scheduler has exited.\n");
+        close(scheduler_fd);
+        scheduler_fd = -1;
+    }
+    return false;
+}
+
+void await_replies(){
+    while (awaiting_count > 0 && read_events(true)) {
+        settle_runs();
+    }
+}
+
+void wait_for_input(){
+    // while we sit at the prompt the scheduler's events are taken as they come, so it never
+    // has to drop any; stdin is unbuffered, so poll() sees everything fgets() would
+    struct pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 } , { scheduler_fd, POLLIN, 0 } };
+    while (poll(fds, 2, -1) > 0 && fds[0].revents == 0) {
+        if (!read_events(false)) {
+            fds[1].fd = -1;
+        }
+    }
+}
+
+void print_exit(int id){
+    ShellJob *job = find_job(id);
+    if (WIFSIGNALED(job->status)) {
+        printf("Job %d.%d (pid %d) was killed by signal %d", session_id, id, job->pid, WTERMSIG(job->status));
+    }
+    else{
+        printf("Job %d.%d (pid %d) exited with status %d", session_id, id, job->pid, WEXITSTATUS(job->status));
+    }
+    printf(" after %.3f ms, waited %.3f ms\n", (double)job->runtime / NSEC_PER_MSEC, (double)job->wait / NSEC_PER_MSEC);
+}
+
+void wait_jobs(char *arg){
+    // wait [id]: until that job, or every job released by run so far, has exited;
+    // ids are the job number or session.job as shown in the history
+    int first = 1 , last , failed = 0;
+    await_replies();
+    last = released_job;
+    if (arg != NULL) {
+        char *dot = strchr(arg, '.');
+        if (dot != NULL && atoi(arg) != session_id) {
+            printf("Job %s was not submitted by this shell.\n", arg);
+            return;
+        }
+        first = last = atoi(dot != NULL ? dot + 1 : arg);
+        if (first < 1 || first > last_job) {
+            printf("No job %s.\n", arg);
+            return;
+        }
+        if (first > released_job) {
+            printf("Job %d.%d has not been released with run yet.\n", session_id, first);
+            return;
+        }
+    }
+    for (int id = first; id <= last; id++)
+    {
+        while (find_job(id)->state != JOB_EXITED) {
+            if (!read_events(true)) {
+                return;
+            }
+        }
+        ShellJob *job = find_job(id);
+        if (arg != NULL) {
+            print_exit(id);
+        }
+        else if (!WIFEXITED(job->status) || WEXITSTATUS(job->status) != 0) {
+            print_exit(id);
+            failed++;
+        }
+    }
+    if (arg == NULL) {
+        printf("%d jobs done, %d failed.\n", last - first + 1, failed);
+    }
+}
+
+void subscribe(){
+    SubscribeRecord record = { { sizeof(SubscribeRecord), MSG_SUBSCRIBE }, 0 };
+    if (send(scheduler_fd, &record, sizeof(record), 0) == -1) {
+        printf("Sending to the scheduler failed.\n");
+    }
+}
+
 void executeScript(char *filename) {
     FILE *file = fopen(filename, "r");
 
@@ -295,7 +754,7 @@ void executeScript(char *filename) {
         return;
     }
 
-    char line[100];
+    char line[MAX_LINE];
     while (fgets(line, sizeof(line), file) != NULL) {
         int len = strlen(line);
         while (len > 0 && newline_checker(line , len)) {
@@ -305,33 +764,60 @@ void executeScript(char *filename) {
         if (len == 0) {
             continue;
         }
+        if (!strcmp(line, "run")) {
+            queue_run();
+            continue;
+        }
+        if (!strncmp(line, "submit ", 7)) {
+            queue_submit(line, -1);
+            continue;
+        }
+        flush_batch();   // whatever the script runs next should see its earlier submits queued
         if (check_for_pipes(line)) {
             char **command_1 = break_pipes_1(line);
             char ***command_2 = break_pipes_2(command_1);
             executePipe(command_2);
         } else {
             char **command_1 = break_spaces(line);
-            executeCommand(command_1);
+            if (!strcmp(command_1[0], "wait")) {
+                wait_jobs(command_1[1]);
+            }
+            else{
+                executeCommand(command_1);
+            }
         }
     }
+    flush_batch();
 
     fclose(file);
 }
 
 void run_scheduler(){   
     char *n_str = (char*)malloc(sizeof(char)*  10);
-    char *t_str = (char*)malloc(sizeof(char)*  10);
+    char *t_str = tslice_str;   // passed through untouched so units like 500us survive
     snprintf(n_str, 10, "%d", ncpu);
-    snprintf(t_str, 10, "%d", tslice);
 
     char *p = "./Simple_Scheduler";
-    char *args[] = {"./Simple_Scheduler" , n_str , t_str,  NULL};
+    char **args = (char**)malloc(sizeof(char*) * (scheduler_argc + 4));
+    if (args == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    args[0] = p;
+    args[1] = n_str;
+    args[2] = t_str;
+    for (int i = 0; i < scheduler_argc; i++)
+    {
+        args[i + 3] = scheduler_argv[i];
+    }
+    args[scheduler_argc + 3] = NULL;
     
     int pid = fork();
     if (pid< 0) {
         printf("Forking child failed.\n");
         exit(1);
     } else if (pid == 0) {
+        setsid();   // outlives this shell and ignores its terminal's ^C, other shells may rely on it
         execvp( p , args );
         printf("Command failed.\n");
         exit(1);
@@ -340,36 +826,33 @@ void run_scheduler(){
     }
 }
 
-void send_message( char *command){
-
-    char* pipename = "/tmp/simple__scheduler_fifo_";
-    if (mkfifo(pipename, 0666) == -1) {
-        printf("fifo not done properly\n");
-        exit(1);
-    }
-    fd = open(pipename, O_WRONLY);
-    if (fd == -1) {
-        printf("couldn't open fd\n");
-        exit(1);
-    }
-    int len = strlen(command);
-
-    write(fd, command, len + 1);
-    close(fd);
-    unlink(pipename);
-}
-
-int main(int argc, char const *argv[]) {
-    if ( argc != 3 )
+int main(int argc, char *argv[]) {
+    if ( argc < 3 )
     {
         printf("NCPU and TSLICE not entered!\n");
         exit(1);
     }
     ncpu = atoi(argv[1]);
-    tslice = atoi( argv [2]);
+    tslice_str = argv[2];
+    scheduler_argc = argc - 3;
+    scheduler_argv = argv + 3;
     setup_signal_handler(); 
-    run_scheduler();   
-    char *str, *str_for_history = (char *)malloc(100);
+    if (connect_scheduler(1)) {
+        printf("Using the scheduler already running on %s, its NCPU and TSLICE apply.\n", socket_path());
+    }
+    else{
+        run_scheduler();   
+        if (!connect_scheduler(200)) {
+            printf("couldn't connect to the scheduler\n");
+            exit(1);
+        }
+    }
+    subscribe();
+    if (getenv("SIMPLE_SCHEDULER_RING") != NULL) {
+        attach_ring();
+    }
+    setvbuf(stdin, NULL, _IONBF, 0);   // see wait_for_input()
+    char *str, *str_for_history = (char *)malloc(MAX_LINE);
     if (str_for_history == NULL) {
         printf("Error allocating memory\n");
         exit(1);
@@ -380,11 +863,14 @@ int main(int argc, char const *argv[]) {
     while (1) {
         getcwd(c, sizeof(c));
         printf("Shell> %s>>> ", c);
+        fflush(stdout);
+        wait_for_input();
         str = Input();
         strcpy(message_str , str);
         if ( !strcmp( "run\n" , str ) )
         {
-            kill( scheduler_pid , SIGUSR1 );
+            queue_run();
+            flush_batch();
             continue;
         }
         
@@ -407,8 +893,18 @@ int main(int argc, char const *argv[]) {
                     char **command_1 = break_spaces(str);
                     if ( !strcmp("submit" , command_1[0]) )
                     {   
+                        // in the history right away, its job id and pid follow with the replies
                         submit_flag = true;
-                        send_message(message_str); 
+                        if (queue_submit(message_str, count_history)) {
+                            count_history = add_to_history(str_for_history, 0, start_time, 0, count_history);
+                            flush_batch();
+                            await_replies();
+                        }
+                    }
+                    else if ( !strcmp("wait" , command_1[0]) )
+                    {
+                        child_pid = 0;
+                        wait_jobs(command_1[1]);
                     }
                     else
                     {